@@ -10,17 +10,199 @@
  ********************************************************************/
 #pragma once
 
+#include <algorithm>  // find_if
+#include <atomic>     // parallel ndjson parsing
+#include <charconv>   // from_chars, to_chars
+#include <chrono>     // statistics timers
+#include <cmath>      // isfinite
 #include <cstdint>    // int64_t
+#include <cstdio>     // snprintf
+#include <cstdlib>    // abort, strtod
+#include <cstring>    // memchr
 #include <exception>  // runtime_error
+#include <functional>  // less_equal
 #include <iostream>
+#include <limits>  // range of bound number members
 #include <map>    // store key-value pairs in json object
-#include <regex>  // remove whitespace from json string
+#include <memory>           // unique_ptr
+#include <memory_resource>  // arena allocation of json trees
+#include <optional>         // optional members of bound structs
+#include <stdexcept>        // out_of_range
 #include <string>
+#include <string_view>  // zero-copy parse input and string values
+#include <tuple>        // field tables of bound structs
+#include <type_traits>
 #include <variant>  // store different types of data in json
 #include <vector>   // store elements in json for _array type
 
+// parse_ndjson() uses a thread pool, define MYJSON_NO_THREADS to parse on
+// the calling thread only
+#if !defined(MYJSON_NO_THREADS)
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// memory-mapped files for parse_file()
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define MYJSON_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// SIMD structural scanner, define MYJSON_NO_SIMD to build only the scalar one
+#if !defined(MYJSON_NO_SIMD) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define MYJSON_SIMD_X86
+#include <immintrin.h>
+#elif !defined(MYJSON_NO_SIMD) && defined(__aarch64__)
+#define MYJSON_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+// Errors are thrown as std::runtime_error. With MYJSON_NO_EXCEPTIONS, which
+// is defined automatically under -fno-exceptions, they print the message
+// and abort instead; parse(str, out) reports parse errors as values either
+// way.
+#if !defined(MYJSON_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && \
+    !defined(__EXCEPTIONS)
+#define MYJSON_NO_EXCEPTIONS
+#endif
+#if defined(MYJSON_NO_EXCEPTIONS)
+#define MYJSON_THROW(exception) \
+    (std::fprintf(stderr, "%s\n", (exception).what()), std::abort())
+#else
+#define MYJSON_THROW(exception) throw exception
+#endif
+
 namespace myjson {
 
+// Statistics
+// define MYJSON_STATS to count what parse(), parse_sax() and dump() do on
+// each thread. Without it the counting hooks compile to nothing and the
+// counters in last_stats() stay zero.
+struct stats {
+    size_t bytes_scanned = 0;  // input read by parse(), output of dump()
+    // tokens by type
+    size_t nulls = 0;
+    size_t bools = 0;
+    size_t ints = 0;
+    size_t floats = 0;
+    size_t strings = 0;  // string values, keys are counted apart
+    size_t keys = 0;
+    size_t arrays = 0;
+    size_t objects = 0;
+    // blocks requested for long strings, arrays and objects, the growth of
+    // an array's or object's own storage is not counted
+    size_t allocations = 0;
+    size_t max_depth = 0;
+    // time spent decoding strings with escapes and converting numbers
+    uint64_t unescape_ns = 0;
+    uint64_t number_ns = 0;
+};
+
+enum class stats_operation { parse, dump };
+
+// receives the counters when the outermost parse() or dump() returns, on
+// the thread that ran it. Set it before parsing starts, it is shared by
+// all threads without locking.
+using stats_callback = std::function<void(stats_operation, const stats&)>;
+
+namespace detail {
+
+stats_callback& stats_hook() {
+    static stats_callback callback;
+    return callback;
+}
+
+stats& thread_stats() {
+    thread_local stats counters;
+    return counters;
+}
+
+// parse() and dump() calls running on this thread, nested calls add to the
+// counters of the outermost one
+size_t& stats_nesting() {
+    thread_local size_t nesting = 0;
+    return nesting;
+}
+
+class stats_scope {
+   public:
+    explicit stats_scope(stats_operation operation) : operation(operation) {
+        if (stats_nesting()++ == 0) {
+            thread_stats() = stats();
+        }
+    }
+    stats_scope(const stats_scope&) = delete;
+    stats_scope& operator=(const stats_scope&) = delete;
+    ~stats_scope() {
+        if (--stats_nesting() == 0 && stats_hook()) {
+            stats_hook()(operation, thread_stats());
+        }
+    }
+
+   private:
+    stats_operation operation;
+};
+
+// adds the lifetime of the timer to counter
+class stats_timer {
+   public:
+    explicit stats_timer(uint64_t& counter)
+        : counter(counter), start(std::chrono::steady_clock::now()) {}
+    stats_timer(const stats_timer&) = delete;
+    stats_timer& operator=(const stats_timer&) = delete;
+    ~stats_timer() {
+        counter += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    }
+
+   private:
+    uint64_t& counter;
+    std::chrono::steady_clock::time_point start;
+};
+
+}  // namespace detail
+
+void set_stats_callback(stats_callback callback) {
+    detail::stats_hook() = std::move(callback);
+}
+
+// the counters of this thread's last parse() or dump()
+const stats& last_stats() { return detail::thread_stats(); }
+
+#if defined(MYJSON_STATS)
+#define MYJSON_STATS_SCOPE(operation) \
+    ::myjson::detail::stats_scope myjson_stats_scope(operation)
+#define MYJSON_STATS_ADD(counter, n) \
+    (::myjson::detail::thread_stats().counter += (n))
+#define MYJSON_STATS_DEPTH(depth)                                      \
+    (::myjson::detail::thread_stats().max_depth =                      \
+         std::max(::myjson::detail::thread_stats().max_depth,          \
+                  static_cast<size_t>(depth)))
+#define MYJSON_STATS_TIME(counter)        \
+    ::myjson::detail::stats_timer myjson_stats_timer( \
+        ::myjson::detail::thread_stats().counter)
+#else
+#define MYJSON_STATS_SCOPE(operation) ((void)0)
+// sizeof keeps the arguments used without evaluating them
+#define MYJSON_STATS_ADD(counter, n) ((void)sizeof(n))
+#define MYJSON_STATS_DEPTH(depth) ((void)sizeof(depth))
+#define MYJSON_STATS_TIME(counter) ((void)0)
+#endif
+
 class json;  // Forward declaration
 
 // Define supported data types
@@ -28,9 +210,235 @@ using _null = std::monostate;
 using _bool = bool;
 using _int = int64_t;
 using _float = double;
-using _string = std::string;
-using _array = std::vector<json>;
-using _object = std::map<std::string, json>;
+// containers use polymorphic allocators so a whole tree can live in an
+// arena, by default they allocate from the heap like std containers
+using _string = std::pmr::string;
+// string value pointing into the parsed buffer (zero-copy parse mode)
+using _string_view = std::string_view;
+using _array = std::pmr::vector<json>;
+// Object keys
+// key of a flat_object or hash_object member: up to inline_capacity
+// characters are stored inline, longer keys are allocated from the
+// object's memory resource or, when shared, point into a key_table
+class object_key {
+   public:
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+    static constexpr size_t inline_capacity = 14;
+
+    object_key(std::string_view key,
+               const allocator_type& alloc = allocator_type());
+    // a copy never shares, it owns its characters
+    object_key(const object_key& other,
+               const allocator_type& alloc = allocator_type());
+    object_key(object_key&& other) noexcept;
+    object_key(object_key&& other, const allocator_type& alloc);
+    object_key& operator=(const object_key& other);
+    object_key& operator=(object_key&& other);
+    ~object_key() { destroy(); }
+
+    // refers to a key interned in a key_table, which must outlive it
+    static object_key shared(std::string_view interned);
+
+    allocator_type get_allocator() const { return allocator_type(resource); }
+    bool is_shared() const { return kind() == Kind::shared; }
+
+    std::string_view view() const;
+    operator std::string_view() const { return view(); }
+    const char* data() const { return view().data(); }
+    size_t size() const { return view().size(); }
+
+    // interned keys usually match by address, without comparing characters
+    bool equals(std::string_view key) const {
+        std::string_view self = view();
+        return (self.data() == key.data() && self.size() == key.size()) ||
+               self == key;
+    }
+    friend bool operator==(const object_key& lhs, std::string_view rhs) {
+        return lhs.equals(rhs);
+    }
+    friend bool operator==(std::string_view lhs, const object_key& rhs) {
+        return rhs.equals(lhs);
+    }
+    friend bool operator!=(const object_key& lhs, std::string_view rhs) {
+        return !lhs.equals(rhs);
+    }
+    friend bool operator!=(std::string_view lhs, const object_key& rhs) {
+        return !rhs.equals(lhs);
+    }
+    friend std::ostream& operator<<(std::ostream& os, const object_key& key) {
+        return os << key.view();
+    }
+
+   private:
+    // bytes 0-7 pointer, 8-11 size of an allocated or shared key, or the
+    // inline characters, byte 14 inline size, byte 15 kind
+    enum class Kind : uint8_t { inline_chars, allocated, shared };
+
+    alignas(8) unsigned char bytes[16];
+    std::pmr::memory_resource* resource;  // owner of an allocated key
+
+    Kind kind() const { return static_cast<Kind>(bytes[15]); }
+    void set(std::string_view key);
+    void take(object_key& other) noexcept;
+    void destroy() noexcept;
+};
+
+// Key interning
+// every distinct key is stored once, so the many objects of an array of
+// records can share the storage of their keys. Not thread-safe.
+class key_table {
+   public:
+    explicit key_table(
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : resource(resource), slots(resource) {}
+    key_table(const key_table&) = delete;
+    key_table& operator=(const key_table&) = delete;
+    ~key_table() { clear(); }
+
+    // the stored copy of key, valid until clear()
+    std::string_view intern(std::string_view key);
+    size_t size() const { return count; }
+    void clear();
+
+   private:
+    std::pmr::memory_resource* resource;
+    // open addressing with linear probing, an empty slot has no data()
+    std::pmr::vector<std::string_view> slots;
+    size_t count = 0;
+
+    void grow();
+};
+
+// Object storage backends, define one of these to replace the default
+// sorted std::pmr::map:
+// MYJSON_FLAT_OBJECT  insertion-ordered vector with linear lookup, the
+//                     fastest for the small objects most documents have
+// MYJSON_HASH_OBJECT  insertion-ordered vector with an open-addressing
+//                     hash index, for objects with many keys
+// Both dump members in insertion order, and like std::vector an insertion
+// invalidates references to other members. Their keys are object_keys and
+// can be shared through a key_table (parse_options::intern_keys).
+class flat_object {
+   public:
+    using value_type = std::pair<object_key, json>;
+    using allocator_type = std::pmr::polymorphic_allocator<value_type>;
+    using iterator = std::pmr::vector<value_type>::iterator;
+    using const_iterator = std::pmr::vector<value_type>::const_iterator;
+
+    flat_object() = default;
+    explicit flat_object(const allocator_type& alloc) : items(alloc) {}
+    flat_object(const flat_object& other, const allocator_type& alloc)
+        : items(other.items, alloc) {}
+    flat_object(flat_object&& other, const allocator_type& alloc)
+        : items(std::move(other.items), alloc) {
+        other.items.clear();
+    }
+    flat_object(const flat_object&) = default;
+    flat_object(flat_object&&) = default;
+    flat_object& operator=(const flat_object&) = default;
+    flat_object& operator=(flat_object&&) = default;
+
+    allocator_type get_allocator() const { return items.get_allocator(); }
+
+    iterator begin() { return items.begin(); }
+    iterator end() { return items.end(); }
+    const_iterator begin() const { return items.begin(); }
+    const_iterator end() const { return items.end(); }
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+    void clear() { items.clear(); }
+    void reserve(size_t n) { items.reserve(n); }
+
+    iterator find(std::string_view key);
+    const_iterator find(std::string_view key) const;
+    // does not replace the value of an existing key, like std::map
+    std::pair<iterator, bool> emplace(std::string_view key, json&& value);
+    std::pair<iterator, bool> emplace(object_key&& key, json&& value);
+    iterator erase(const_iterator it) { return items.erase(it); }
+
+    // same members regardless of their order
+    friend bool operator==(const flat_object& lhs, const flat_object& rhs);
+    friend bool operator!=(const flat_object& lhs, const flat_object& rhs) {
+        return !(lhs == rhs);
+    }
+
+   private:
+    std::pmr::vector<value_type> items;
+};
+
+class hash_object {
+   public:
+    using value_type = std::pair<object_key, json>;
+    using allocator_type = std::pmr::polymorphic_allocator<value_type>;
+    using iterator = std::pmr::vector<value_type>::iterator;
+    using const_iterator = std::pmr::vector<value_type>::const_iterator;
+
+    hash_object() = default;
+    explicit hash_object(const allocator_type& alloc)
+        : entries(alloc), slots(alloc) {}
+    hash_object(const hash_object& other, const allocator_type& alloc)
+        : entries(other.entries, alloc), slots(other.slots, alloc) {}
+    hash_object(hash_object&& other, const allocator_type& alloc)
+        : entries(std::move(other.entries), alloc),
+          slots(std::move(other.slots), alloc) {
+        other.clear();
+    }
+    hash_object(const hash_object&) = default;
+    hash_object(hash_object&&) = default;
+    hash_object& operator=(const hash_object&) = default;
+    hash_object& operator=(hash_object&&) = default;
+
+    allocator_type get_allocator() const { return entries.get_allocator(); }
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear() {
+        entries.clear();
+        slots.clear();
+    }
+    // the index still grows as members are added
+    void reserve(size_t n) { entries.reserve(n); }
+
+    iterator find(std::string_view key);
+    const_iterator find(std::string_view key) const;
+    // does not replace the value of an existing key, like std::map
+    std::pair<iterator, bool> emplace(std::string_view key, json&& value);
+    std::pair<iterator, bool> emplace(object_key&& key, json&& value);
+    // keeps insertion order, so the index is rebuilt, O(n)
+    iterator erase(const_iterator it);
+
+    // same members regardless of their order
+    friend bool operator==(const hash_object& lhs, const hash_object& rhs);
+    friend bool operator!=(const hash_object& lhs, const hash_object& rhs) {
+        return !(lhs == rhs);
+    }
+
+   private:
+    // objects this small are searched linearly, without an index
+    static constexpr size_t index_threshold = 8;
+
+    std::pmr::vector<value_type> entries;  // in insertion order
+    // open addressing with linear probing, entry index + 1, 0 is empty
+    std::pmr::vector<uint32_t> slots;
+
+    // index of key in entries, or entries.size()
+    size_t find_index(std::string_view key) const;
+    void insert_slot(size_t index);
+    void index_entry(size_t index);
+    void rebuild_index();
+};
+
+#if defined(MYJSON_FLAT_OBJECT)
+using _object = flat_object;
+#elif defined(MYJSON_HASH_OBJECT)
+using _object = hash_object;
+#else
+using _object = std::pmr::map<_string, json, std::less<>>;
+#endif
 
 // Helper functions for json class in get<type>() and get_to<type>() interface
 void from_json(const json& j, _null& value);
@@ -51,42 +459,107 @@ void to_json(json& j, int64_t value);
 void to_json(json& j, float value);
 void to_json(json& j, double value);
 void to_json(json& j, const std::string& value);
+void to_json(json& j, const _string& value);
 void to_json(json& j, const char* value);
 void to_json(json& j, const _array& value);
 void to_json(json& j, const _object& value);
+void to_json(json& j, _string&& value);
+void to_json(json& j, _array&& value);
+void to_json(json& j, _object&& value);
+
+// Serialization options
+struct dump_options {
+    // write "," and ":" instead of ", " and ": "
+    bool compact = false;
+};
+
+// Destination for dump_to(), receives the output in chunks
+class output_sink {
+   public:
+    virtual ~output_sink() = default;
+    virtual void write(const char* data, size_t size) = 0;
+};
+
+class ostream_sink : public output_sink {
+   public:
+    explicit ostream_sink(std::ostream& os) : os(os) {}
+    void write(const char* data, size_t size) override {
+        os.write(data, static_cast<std::streamsize>(size));
+    }
+
+   private:
+    std::ostream& os;
+};
 
 // Define concrete class json
 class json {
    public:
     using Value =
-        std::variant<_null, _bool, _int, _float, _string, _array, _object>;
-    // for simplicity, we use std::variant to store different types of data
+        std::variant<_null, _bool, _int, _float, _string, _array, _object,
+                     _string_view>;
+    // std::variant holding a copy of the value, returned by get_data()
+    // _string and _string_view are both reported as Type::_string
     enum class Type { _null, _bool, _int, _float, _string, _array, _object };
     // for simplicity, we use enum class to define different types of json
     // object and compare in some functions
 
-    Type type;   // Type of json object
-    Value data;  // Data stored in json object
+    // json is allocator-aware: a value inserted into an _array or _object
+    // is copied into the memory resource of that container
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
 
     // Constructors
-    json() : type(Type::_null), data(_null()) {};
-    json(bool value) : type(Type::_bool), data(value) {};
-    json(int value) : type(Type::_int), data(static_cast<int64_t>(value)) {};
-    json(int64_t value) : type(Type::_int), data(value) {};
-    json(float value) : type(Type::_float), data(static_cast<double>(value)) {};
-    json(double value) : type(Type::_float), data(value) {};
-    json(const std::string& value) : type(Type::_string), data(value) {};
-    json(const char* value)
-        : type(Type::_string), data(static_cast<std::string>(value)) {};
-    json(const _array& value) : type(Type::_array), data(value) {};
-    json(const _object& value) : type(Type::_object), data(value) {};
+    json() { set_kind(Kind::null); };
+    json(bool value) { set_scalar(Kind::boolean, value); };
+    json(int value) { set_scalar(Kind::integer, static_cast<_int>(value)); };
+    json(int64_t value) { set_scalar(Kind::integer, value); };
+    json(float value) {
+        set_scalar(Kind::number, static_cast<_float>(value));
+    };
+    json(double value) { set_scalar(Kind::number, value); };
+    json(const std::string& value) { set_string(value, default_resource()); };
+    json(const _string& value) { set_string(value, default_resource()); };
+    json(const char* value) { set_string(value, default_resource()); };
+    json(const _array& value) {
+        set_pointer(Kind::array, make_rep<_array>(default_resource(), value));
+    };
+    json(const _object& value) {
+        set_pointer(Kind::object,
+                    make_rep<_object>(default_resource(), value));
+    };
+    // take over containers, keeping the memory resource they allocate from
+    json(_string&& value);
+    json(_array&& value) {
+        auto resource = value.get_allocator().resource();
+        set_pointer(Kind::array, make_rep<_array>(resource, std::move(value)));
+    };
+    json(_object&& value) {
+        auto resource = value.get_allocator().resource();
+        set_pointer(Kind::object,
+                    make_rep<_object>(resource, std::move(value)));
+    };
+
+    // string value that points into str instead of copying it, str must
+    // outlive the json object (zero-copy parse mode)
+    static json make_view(std::string_view str);
 
     // Copy and Move Constructors
-    json(const json& other) : type(other.type), data(other.data) {};
-    json(json&& other) : type(other.type), data(std::move(other.data)) {};
+    json(const json& other) { copy_from(other, default_resource()); };
+    // noexcept, so vectors move elements on growth instead of copying them
+    // out of their memory resource
+    json(json&& other) noexcept { take(other); };
+
+    // Allocator-extended Constructors, used by pmr containers
+    explicit json(const allocator_type&) : json() {};
+    json(const json& other, const allocator_type& alloc) {
+        copy_from(other, alloc.resource());
+    };
+    json(json&& other, const allocator_type& alloc);
 
     // Destructor
-    ~json() = default;
+    ~json() { destroy(); };
+
+    // empty array with room for capacity elements
+    static json array(size_t capacity = 0);
 
     // Accessors
     // return costum type(enum class Type), different from use type
@@ -94,42 +567,90 @@ class json {
     std::string get_type_as_string() const;
     // return data(std::variant) stored in json object
     Value get_data() const;
+    // return owned or zero-copy string without copying, only for _string
+    std::string_view get_string_view() const;
+    // return the stored value without copying, throw on other types
+    _bool as_bool() const;
+    _int as_int() const;
+    _float as_float() const;
+    _array& as_array();
+    const _array& as_array() const;
+    _object& as_object();
+    const _object& as_object() const;
+
+    // member of an _object, nullptr if it is missing or json is no object
+    json* find(std::string_view key);
+    const json* find(std::string_view key) const;
+    bool contains(std::string_view key) const;
 
     // for costum type, get value from json object // defined from_json()
     template <class T>
-    auto get() -> T;
+    auto get() const -> T;
 
     // for costum type, assign value to json object // defined to_json()
     template <class T>
-    void get_to(T& value);
+    void get_to(T& value) const;
 
-    // return std::vector<json> and std::map<std::string, json>
-    auto to_array() const -> _array;
-    auto to_map() const -> _object;
+    // return std::vector<json> and std::map<std::string, json>, without
+    // copying them
+    auto to_array() const -> const _array&;
+    auto to_map() const -> const _object&;
 
     // Modifiers
     void push(const json& value);         // only for _array
+    void push(json&& value);              // only for _array
     void pop();                           // only for _array
-    void remove(const std::string& key);  // only for _object
+    void remove(std::string_view key);    // only for _object
+    // room for n elements or members without reallocating. std::map
+    // objects allocate every member separately and ignore it.
+    void reserve(size_t n);
+    // construct the new element from args, only for _array
+    template <class... Args>
+    json& emplace_back(Args&&... args);
+    // construct the member from args unless key exists, like std::map,
+    // and return it, only for _object
+    template <class... Args>
+    json& emplace(std::string_view key, Args&&... args);
+
+    // Sharing
+    // make strings, arrays and objects of this tree reference-counted and
+    // move them to the default resource. Copying the tree or any subtree is
+    // then O(1), and any number of threads may read and copy it at once. A
+    // write through a non-const accessor copies only the shared nodes on
+    // its path, values added afterwards are copied deeply until the next
+    // share(). Throws for nodes of an arena, which never releases them,
+    // share a heap copy of the tree instead.
+    void share();
+    bool is_shared() const;
 
     // Operators
+    json& operator[](std::string_view key);
     json& operator[](const std::string& key);
     json& operator[](const char* key);
     json& operator[](int index);
     json& operator[](size_t index);
 
-    // for const json object
-    json operator[](const std::string& key) const;
-    json operator[](const char* key) const;
-    json operator[](int index) const;
-    json operator[](size_t index) const;
+    // for const json object, reads without copying the subtree
+    const json& operator[](std::string_view key) const;
+    const json& operator[](const std::string& key) const;
+    const json& operator[](const char* key) const;
+    const json& operator[](int index) const;
+    const json& operator[](size_t index) const;
 
     // for costum type, assign value to json object // defined to_json()
     template <class T>
     json& operator=(const T& value);
 
+    // a long string, array or object in a memory resource other than the
+    // default one keeps allocating from it, and a node that lives in an
+    // arena allocates from the arena, so assigning over any node of an
+    // arena tree copies the value into the arena
     json& operator=(const json& other);
     json& operator=(json&& other);
+    // take over containers instead of copying them
+    json& operator=(_string&& value);
+    json& operator=(_array&& value);
+    json& operator=(_object&& value);
 
     // operator overloading
     // simplify Output operator
@@ -139,127 +660,565 @@ class json {
     friend bool operator!=(const json& lhs, const json& rhs);
 
     // Conversion functions
-    std::string dump() const;  // convert json object to string
+    // convert json object to string
+    std::string dump(const dump_options& options = dump_options()) const;
+    // append to out / write to os or sink, without intermediate strings
+    void dump_to(std::string& out,
+                 const dump_options& options = dump_options()) const;
+    void dump_to(std::ostream& os,
+                 const dump_options& options = dump_options()) const;
+    void dump_to(output_sink& sink,
+                 const dump_options& options = dump_options()) const;
+
+   private:
+    // Node layout, 16 bytes:
+    // bytes 0-7   bool, int, double, pointer to an out-of-line container
+    //             or string, or the first characters of a short string
+    // bytes 8-13  size of a zero-copy string, or more short string chars
+    // byte  14    size of a short string
+    // byte  15    kind of value
+    enum class Kind : uint8_t {
+        null,
+        boolean,
+        integer,
+        number,
+        short_string,  // stored inline
+        long_string,   // _string allocated out of line
+        string_view,   // points into the parsed buffer
+        array,         // _array allocated out of line
+        object,        // _object allocated out of line
+        shared_string,  // reference-counted _string
+        shared_array,   // reference-counted _array
+        shared_object   // reference-counted _object
+    };
+    static constexpr size_t max_short_string = 14;
+
+    alignas(8) unsigned char bytes[16];
+
+    Kind kind() const { return static_cast<Kind>(bytes[15]); }
+    void set_kind(Kind kind) { bytes[15] = static_cast<unsigned char>(kind); }
+
+    template <class T>
+    T load(size_t offset) const {
+        T value;
+        std::memcpy(&value, bytes + offset, sizeof(T));
+        return value;
+    }
+    template <class T>
+    void store(size_t offset, T value) {
+        std::memcpy(bytes + offset, &value, sizeof(T));
+    }
+    template <class T>
+    void set_scalar(Kind kind, T value) {
+        store(0, value);
+        set_kind(kind);
+    }
+    template <class T>
+    void set_pointer(Kind kind, T* pointer) {
+        store(0, pointer);
+        set_kind(kind);
+    }
+    template <class T>
+    T* pointer() const {
+        return load<T*>(0);
+    }
+
+    static std::pmr::memory_resource* default_resource() {
+        return std::pmr::get_default_resource();
+    }
+    // the resource of the out-of-line storage, the default one for scalars
+    std::pmr::memory_resource* resource() const;
+    // where value has to be copied to when it is assigned to this node:
+    // the resource of this node, or the arena it lives in
+    std::pmr::memory_resource* target_resource(const json& value) const;
+
+    // out-of-line storage using resource for itself and its contents
+    template <class T, class... Args>
+    static T* make_rep(std::pmr::memory_resource* resource, Args&&... args);
+    template <class T>
+    static void free_rep(T* rep);
+
+    // storage of the shared kinds, written in place only while a single
+    // node refers to it
+    template <class T>
+    struct shared_rep {
+        std::atomic<size_t> references{1};
+        T value;
+
+        template <class Value>
+        explicit shared_rep(Value&& value)
+            : value(std::forward<Value>(value)) {}
+    };
+    template <class T, class Value>
+    static shared_rep<T>* make_shared_rep(Value&& value) {
+        MYJSON_STATS_ADD(allocations, 1);
+        void* storage =
+            default_resource()->allocate(sizeof(shared_rep<T>),
+                                         alignof(shared_rep<T>));
+#if defined(MYJSON_NO_EXCEPTIONS)
+        return new (storage) shared_rep<T>(std::forward<Value>(value));
+#else
+        try {
+            return new (storage) shared_rep<T>(std::forward<Value>(value));
+        } catch (...) {
+            default_resource()->deallocate(storage, sizeof(shared_rep<T>),
+                                           alignof(shared_rep<T>));
+            throw;
+        }
+#endif
+    }
+    template <class T>
+    static void release(shared_rep<T>* rep) noexcept {
+        if (rep->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            rep->~shared_rep<T>();
+            default_resource()->deallocate(rep, sizeof(shared_rep<T>),
+                                           alignof(shared_rep<T>));
+        }
+    }
+    // a private copy of the shared storage, before it is written
+    void unshare();
+    // share() without the arena check, for the nodes below one
+    void share_nodes();
+
+    void set_string(std::string_view str, std::pmr::memory_resource* resource);
+    void copy_from(const json& other, std::pmr::memory_resource* resource);
+    void take(json& other) noexcept;
+    void destroy() noexcept;
 };
+
+static_assert(sizeof(json) == 16, "json node should stay 16 bytes");
 // Helper functions
+namespace detail {
+
+// out set to the number scalar converted to T, unless T cannot hold it.
+// Floats convert to integers truncated toward zero.
+template <class T>
+bool convert_number(const json& scalar, T& out) {
+    using limits = std::numeric_limits<T>;
+    if (scalar.get_type() == json::Type::_int) {
+        _int value = scalar.as_int();
+        if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+            if (value < _int(limits::min()) || value > _int(limits::max())) {
+                return false;
+            }
+        } else if constexpr (std::is_integral_v<T>) {
+            if (value < 0 || uint64_t(value) > uint64_t(limits::max())) {
+                return false;
+            }
+        }
+        out = static_cast<T>(value);
+        return true;
+    }
+    _float value = scalar.as_float();
+    if constexpr (std::is_integral_v<T>) {
+        // 2^digits is exact, unlike max() + 1 for 64-bit types
+        _float end = std::ldexp(_float(1), limits::digits);
+        _float start = std::is_signed_v<T> ? -end : _float(0);
+        _float truncated = std::trunc(value);
+        if (!(truncated >= start && truncated < end)) {
+            return false;
+        }
+    } else if (std::fabs(value) > _float(limits::max())) {
+        return false;
+    }
+    out = static_cast<T>(value);
+    return true;
+}
+
+}  // namespace detail
+
 void from_json(const json& j, _null& value) { value = _null(); }
 
 void from_json(const json& j, bool& value) {
-    if (j.type == json::Type::_bool) {
-        value = std::get<_bool>(j.data);
+    if (j.get_type() == json::Type::_bool) {
+        value = j.as_bool();
     }
 }
 
+// a number out of the range of value leaves it unchanged
 void from_json(const json& j, int& value) {
-    if (j.type == json::Type::_int) {
-        value = static_cast<int>(std::get<_int>(j.data));
-    } else if (j.type == json::Type::_float) {
-        value = static_cast<int>(std::get<_float>(j.data));
+    if (j.get_type() == json::Type::_int ||
+        j.get_type() == json::Type::_float) {
+        detail::convert_number(j, value);
     }
 }
 
 void from_json(const json& j, int64_t& value) {
-    if (j.type == json::Type::_int) {
-        value = std::get<_int>(j.data);
-    } else if (j.type == json::Type::_float) {
-        value = static_cast<int64_t>(std::get<_float>(j.data));
+    if (j.get_type() == json::Type::_int ||
+        j.get_type() == json::Type::_float) {
+        detail::convert_number(j, value);
     }
 }
 
 void from_json(const json& j, float& value) {
-    if (j.type == json::Type::_float) {
-        value = static_cast<float>(std::get<_float>(j.data));
-    } else if (j.type == json::Type::_int) {
-        value = static_cast<float>(std::get<_int>(j.data));
+    if (j.get_type() == json::Type::_float ||
+        j.get_type() == json::Type::_int) {
+        detail::convert_number(j, value);
     }
 }
 
 void from_json(const json& j, double& value) {
-    if (j.type == json::Type::_float) {
-        value = std::get<_float>(j.data);
-    } else if (j.type == json::Type::_int) {
-        value = static_cast<double>(std::get<_int>(j.data));
+    if (j.get_type() == json::Type::_float) {
+        value = j.as_float();
+    } else if (j.get_type() == json::Type::_int) {
+        value = static_cast<double>(j.as_int());
     }
 }
 
 void from_json(const json& j, std::string& value) {
-    if (j.type == json::Type::_string) {
-        value = std::get<_string>(j.data);
+    if (j.get_type() == json::Type::_string) {
+        value = std::string(j.get_string_view());
     }
 }
 
 void from_json(const json& j, char* value) {
-    if (j.type == json::Type::_string) {
-        value = const_cast<char*>(std::get<_string>(j.data).c_str());
+    if (j.get_type() == json::Type::_string) {
+        value = const_cast<char*>(j.get_string_view().data());
     }
 }
 
 void from_json(const json& j, _array& value) {
-    if (j.type == json::Type::_array) {
-        value = std::get<_array>(j.data);
+    if (j.get_type() == json::Type::_array) {
+        value = j.as_array();
     }
 }
 
 void from_json(const json& j, _object& value) {
-    if (j.type == json::Type::_object) {
-        value = std::get<_object>(j.data);
+    if (j.get_type() == json::Type::_object) {
+        value = j.as_object();
+    }
+}
+
+void to_json(json& j, const _null&) { j = json(); }
+
+void to_json(json& j, bool value) { j = json(value); }
+
+void to_json(json& j, int value) { j = json(value); }
+
+void to_json(json& j, int64_t value) { j = json(value); }
+
+void to_json(json& j, float value) { j = json(value); }
+
+void to_json(json& j, double value) { j = json(value); }
+
+void to_json(json& j, const std::string& value) { j = json(value); }
+
+void to_json(json& j, const _string& value) { j = json(value); }
+
+void to_json(json& j, const char* value) { j = json(value); }
+
+void to_json(json& j, const _array& value) { j = json(value); }
+
+void to_json(json& j, const _object& value) { j = json(value); }
+
+void to_json(json& j, _string&& value) { j = json(std::move(value)); }
+
+void to_json(json& j, _array&& value) { j = json(std::move(value)); }
+
+void to_json(json& j, _object&& value) { j = json(std::move(value)); }
+
+// Arena registry
+// the blocks of every live arena. A null, number or short string node has
+// no room to record the memory resource of the tree it belongs to, so a
+// heap value assigned over it looks up whether the node itself lives in an
+// arena, and is copied there (see json::operator=)
+namespace detail {
+
+class arena_registry {
+   public:
+    // never destroyed, arenas in static storage may outlive it otherwise
+    static arena_registry& instance() {
+        static arena_registry* registry = new arena_registry();
+        return *registry;
+    }
+
+    void add(const void* block, size_t size,
+             std::pmr::memory_resource* resource) {
+        uintptr_t start = reinterpret_cast<uintptr_t>(block);
+        lock_guard lock(mutex);
+        auto at = std::lower_bound(blocks.begin(), blocks.end(), start,
+                                   starts_before);
+        blocks.insert(at, {start, start + size, resource});
+        changed();
+    }
+
+    // before the block is freed, so that a node allocated in its place
+    // later is not taken for part of the arena
+    void remove(const void* block) {
+        uintptr_t start = reinterpret_cast<uintptr_t>(block);
+        lock_guard lock(mutex);
+        auto at = std::lower_bound(blocks.begin(), blocks.end(), start,
+                                   starts_before);
+        if (at != blocks.end() && at->start == start) {
+            blocks.erase(at);
+        }
+        changed();
+    }
+
+    // the arena whose blocks hold address, nullptr if there is none. Reads
+    // a copy of the blocks kept per thread, taken again after any change.
+    std::pmr::memory_resource* find(const void* address) {
+        if (count.load(std::memory_order_acquire) == 0) {
+            return nullptr;
+        }
+        thread_local snapshot copy;
+        size_t current = generation.load(std::memory_order_acquire);
+        if (copy.generation != current) {
+            lock_guard lock(mutex);
+            copy.blocks = blocks;
+            copy.generation = generation.load(std::memory_order_relaxed);
+        }
+        uintptr_t at = reinterpret_cast<uintptr_t>(address);
+        auto next = std::upper_bound(
+            copy.blocks.begin(), copy.blocks.end(), at,
+            [](uintptr_t value, const block_range& block) {
+                return value < block.start;
+            });
+        if (next == copy.blocks.begin() || at >= (next - 1)->end) {
+            return nullptr;
+        }
+        return (next - 1)->resource;
+    }
+
+   private:
+    struct block_range {
+        uintptr_t start;
+        uintptr_t end;
+        std::pmr::memory_resource* resource;
+    };
+    struct snapshot {
+        size_t generation = SIZE_MAX;
+        std::vector<block_range> blocks;
+    };
+    std::vector<block_range> blocks;  // sorted by start
+    std::atomic<size_t> count{0};       // size of blocks
+    std::atomic<size_t> generation{0};  // changes of blocks
+#if defined(MYJSON_NO_THREADS)
+    struct no_mutex {};
+    struct lock_guard {
+        explicit lock_guard(no_mutex&) {}
+    };
+    no_mutex mutex;
+#else
+    using lock_guard = std::lock_guard<std::mutex>;
+    std::mutex mutex;
+#endif
+
+    static bool starts_before(const block_range& block, uintptr_t start) {
+        return block.start < start;
+    }
+    void changed() {
+        generation.fetch_add(1, std::memory_order_release);
+        count.store(blocks.size(), std::memory_order_release);
+    }
+};
+
+}  // namespace detail
+
+// Node storage
+template <class T, class... Args>
+T* json::make_rep(std::pmr::memory_resource* resource, Args&&... args) {
+    MYJSON_STATS_ADD(allocations, 1);
+    void* storage = resource->allocate(sizeof(T), alignof(T));
+#if defined(MYJSON_NO_EXCEPTIONS)
+    return new (storage)
+        T(std::forward<Args>(args)..., allocator_type(resource));
+#else
+    try {
+        return new (storage)
+            T(std::forward<Args>(args)..., allocator_type(resource));
+    } catch (...) {
+        resource->deallocate(storage, sizeof(T), alignof(T));
+        throw;
     }
+#endif
 }
 
-void to_json(json& j, const _null& value) {
-    j.data = value;
-    j.type = json::Type::_null;
+template <class T>
+void json::free_rep(T* rep) {
+    std::pmr::memory_resource* resource = rep->get_allocator().resource();
+    rep->~T();
+    resource->deallocate(rep, sizeof(T), alignof(T));
+}
+
+std::pmr::memory_resource* json::resource() const {
+    if (kind() == Kind::long_string) {
+        return pointer<_string>()->get_allocator().resource();
+    } else if (kind() == Kind::array) {
+        return pointer<_array>()->get_allocator().resource();
+    } else if (kind() == Kind::object) {
+        return pointer<_object>()->get_allocator().resource();
+    }
+    // and shared storage is always in the default resource
+    return default_resource();
 }
 
-void to_json(json& j, bool value) {
-    j.data = value;
-    j.type = json::Type::_bool;
+std::pmr::memory_resource* json::target_resource(const json& value) const {
+    std::pmr::memory_resource* target = resource();
+    if (value.kind() < Kind::long_string || value.kind() == Kind::string_view ||
+        target != default_resource()) {
+        return target;
+    }
+    // heap storage assigned over a node without storage of its own
+    if (value.resource() == target) {
+        std::pmr::memory_resource* arena =
+            detail::arena_registry::instance().find(this);
+        if (arena != nullptr) {
+            return arena;
+        }
+    }
+    return target;
 }
 
-void to_json(json& j, int value) {
-    j.data = static_cast<int64_t>(value);
-    j.type = json::Type::_int;
+void json::set_string(std::string_view str,
+                      std::pmr::memory_resource* resource) {
+    if (str.size() <= max_short_string) {
+        std::memcpy(bytes, str.data(), str.size());
+        bytes[14] = static_cast<unsigned char>(str.size());
+        set_kind(Kind::short_string);
+    } else {
+        set_pointer(Kind::long_string, make_rep<_string>(resource, str));
+    }
 }
 
-void to_json(json& j, int64_t value) {
-    j.data = value;
-    j.type = json::Type::_int;
+json::json(_string&& value) {
+    if (value.size() <= max_short_string) {
+        set_string(value, default_resource());
+    } else {
+        auto resource = value.get_allocator().resource();
+        set_pointer(Kind::long_string,
+                    make_rep<_string>(resource, std::move(value)));
+    }
 }
 
-void to_json(json& j, float value) {
-    j.data = static_cast<double>(value);
-    j.type = json::Type::_float;
+json::json(json&& other, const allocator_type& alloc) {
+    if (other.resource() == alloc.resource()) {
+        take(other);
+    } else {
+        copy_from(other, alloc.resource());
+    }
 }
 
-void to_json(json& j, double value) {
-    j.data = value;
-    j.type = json::Type::_float;
+json json::make_view(std::string_view str) {
+    json result;
+    if (str.size() > UINT32_MAX) {
+        // the node only has room for a 32-bit size
+        result.set_string(str, default_resource());
+        return result;
+    }
+    result.store(0, str.data());
+    result.store(8, static_cast<uint32_t>(str.size()));
+    result.set_kind(Kind::string_view);
+    return result;
 }
 
-void to_json(json& j, const std::string& value) {
-    j.data = value;
-    j.type = json::Type::_string;
+void json::copy_from(const json& other, std::pmr::memory_resource* resource) {
+    if (other.kind() == Kind::long_string) {
+        set_pointer(Kind::long_string,
+                    make_rep<_string>(resource, *other.pointer<_string>()));
+    } else if (other.kind() == Kind::array) {
+        set_pointer(Kind::array,
+                    make_rep<_array>(resource, *other.pointer<_array>()));
+    } else if (other.kind() == Kind::object) {
+        set_pointer(Kind::object,
+                    make_rep<_object>(resource, *other.pointer<_object>()));
+    } else if (other.is_shared() && resource != default_resource()) {
+        // shared storage is on the heap, other resources get a deep copy
+        if (other.kind() == Kind::shared_string) {
+            set_string(other.pointer<shared_rep<_string>>()->value, resource);
+        } else if (other.kind() == Kind::shared_array) {
+            set_pointer(Kind::array,
+                        make_rep<_array>(
+                            resource,
+                            other.pointer<shared_rep<_array>>()->value));
+        } else {
+            set_pointer(Kind::object,
+                        make_rep<_object>(
+                            resource,
+                            other.pointer<shared_rep<_object>>()->value));
+        }
+    } else {
+        // scalars, short strings and zero-copy strings are plain bytes,
+        // shared storage gains a reference
+        std::memcpy(bytes, other.bytes, sizeof(bytes));
+        if (other.kind() == Kind::shared_string) {
+            pointer<shared_rep<_string>>()->references.fetch_add(
+                1, std::memory_order_relaxed);
+        } else if (other.kind() == Kind::shared_array) {
+            pointer<shared_rep<_array>>()->references.fetch_add(
+                1, std::memory_order_relaxed);
+        } else if (other.kind() == Kind::shared_object) {
+            pointer<shared_rep<_object>>()->references.fetch_add(
+                1, std::memory_order_relaxed);
+        }
+    }
 }
 
-void to_json(json& j, const char* value) {
-    j.data = static_cast<std::string>(value);
-    j.type = json::Type::_string;
+void json::take(json& other) noexcept {
+    std::memcpy(bytes, other.bytes, sizeof(bytes));
+    other.set_kind(Kind::null);
 }
 
-void to_json(json& j, const _array& value) {
-    j.data = value;
-    j.type = json::Type::_array;
+void json::destroy() noexcept {
+    if (kind() == Kind::long_string) {
+        free_rep(pointer<_string>());
+    } else if (kind() == Kind::array) {
+        free_rep(pointer<_array>());
+    } else if (kind() == Kind::object) {
+        free_rep(pointer<_object>());
+    } else if (kind() == Kind::shared_string) {
+        release(pointer<shared_rep<_string>>());
+    } else if (kind() == Kind::shared_array) {
+        release(pointer<shared_rep<_array>>());
+    } else if (kind() == Kind::shared_object) {
+        release(pointer<shared_rep<_object>>());
+    }
+    set_kind(Kind::null);
 }
 
-void to_json(json& j, const _object& value) {
-    j.data = value;
-    j.type = json::Type::_object;
+void json::unshare() {
+    if (kind() == Kind::shared_string) {
+        auto rep = pointer<shared_rep<_string>>();
+        if (rep->references.load(std::memory_order_acquire) != 1) {
+            set_pointer(Kind::shared_string,
+                        make_shared_rep<_string>(rep->value));
+            release(rep);
+        }
+    } else if (kind() == Kind::shared_array) {
+        // the elements are shared, so copying them is shallow
+        auto rep = pointer<shared_rep<_array>>();
+        if (rep->references.load(std::memory_order_acquire) != 1) {
+            set_pointer(Kind::shared_array,
+                        make_shared_rep<_array>(rep->value));
+            release(rep);
+        }
+    } else if (kind() == Kind::shared_object) {
+        auto rep = pointer<shared_rep<_object>>();
+        if (rep->references.load(std::memory_order_acquire) != 1) {
+            set_pointer(Kind::shared_object,
+                        make_shared_rep<_object>(rep->value));
+            release(rep);
+        }
+    }
 }
 
 // Accessors
-json::Type json::get_type() const { return type; }
+json::Type json::get_type() const {
+    switch (kind()) {
+        case Kind::null: return Type::_null;
+        case Kind::boolean: return Type::_bool;
+        case Kind::integer: return Type::_int;
+        case Kind::number: return Type::_float;
+        case Kind::array:
+        case Kind::shared_array: return Type::_array;
+        case Kind::object:
+        case Kind::shared_object: return Type::_object;
+        default: return Type::_string;
+    }
+}
 
 std::string json::get_type_as_string() const {
+    Type type = get_type();
     if (type == Type::_null)
         return "null";
     else if (type == Type::_bool)
@@ -278,406 +1237,6024 @@ std::string json::get_type_as_string() const {
         return std::string("Unknown type");
 }
 
-json::Value json::get_data() const { return data; }
-
-template <class T>
-auto json::get() -> T {
-    T result;
-    from_json(*this, result);
-    return result;
-}
-
-template <class T>
-void json::get_to(T& value) {
-    from_json(*this, value);
-}
-
-auto json::to_array() const -> _array {
-    if (type == Type::_array) {
-        return std::get<_array>(data);
-    } else {
-        throw std::runtime_error("At to_array(): json is not an array");
+json::Value json::get_data() const {
+    switch (kind()) {
+        case Kind::null: return Value(_null());
+        case Kind::boolean: return Value(as_bool());
+        case Kind::integer: return Value(as_int());
+        case Kind::number: return Value(as_float());
+        case Kind::string_view: return Value(get_string_view());
+        case Kind::array:
+        case Kind::shared_array: return Value(as_array());
+        case Kind::object:
+        case Kind::shared_object: return Value(as_object());
+        default:
+            return Value(std::in_place_type<_string>, get_string_view());
     }
 }
 
-auto json::to_map() const -> _object {
-    if (type == Type::_object) {
-        return std::get<_object>(data);
+std::string_view json::get_string_view() const {
+    if (kind() == Kind::short_string) {
+        return std::string_view(reinterpret_cast<const char*>(bytes),
+                                bytes[14]);
+    } else if (kind() == Kind::long_string) {
+        return *pointer<_string>();
+    } else if (kind() == Kind::shared_string) {
+        return pointer<shared_rep<_string>>()->value;
+    } else if (kind() == Kind::string_view) {
+        return std::string_view(pointer<const char>(), load<uint32_t>(8));
     } else {
-        throw std::runtime_error("At to_map(): json is not an object");
+        MYJSON_THROW(
+            std::runtime_error("At get_string_view(): json is not a string"));
     }
 }
 
-// Modifiers
-void json::push(const json& value) {
-    if (type == Type::_array) {
-        std::get<_array>(data).push_back(value);
-    } else {
-        throw std::runtime_error("At push(): json is not an array");
+_bool json::as_bool() const {
+    if (kind() != Kind::boolean) {
+        MYJSON_THROW(std::runtime_error("At as_bool(): json is not a bool"));
     }
+    return load<_bool>(0);
 }
 
-void json::pop() {
-    if (type == Type::_array) {
-        std::get<_array>(data).pop_back();
-    } else {
-        throw std::runtime_error("At pop(): json is not an array");
+_int json::as_int() const {
+    if (kind() != Kind::integer) {
+        MYJSON_THROW(std::runtime_error("At as_int(): json is not an int"));
     }
+    return load<_int>(0);
 }
 
-void json::remove(const std::string& key) {
-    if (type == Type::_object) {
-        std::get<_object>(data).erase(key);
-    } else {
-        throw std::runtime_error("At remove(): json is not an object");
+_float json::as_float() const {
+    if (kind() != Kind::number) {
+        MYJSON_THROW(std::runtime_error("At as_float(): json is not a float"));
     }
+    return load<_float>(0);
 }
 
-// Operators
-json& json::operator[](const std::string& key) {
-    if (type != Type::_object) {
-        throw std::runtime_error("At operator[]: json is not an object");
+_array& json::as_array() {
+    if (kind() == Kind::shared_array) {
+        unshare();
+        return pointer<shared_rep<_array>>()->value;
     }
-    return std::get<_object>(data)[key];
-}
-
-json& json::operator[](const char* key) { return operator[](std::string(key)); }
-
-json& json::operator[](int index) {
-    if (index < 0) {
-        throw std::runtime_error("At operator[]: index is negative");
+    if (kind() != Kind::array) {
+        MYJSON_THROW(std::runtime_error("At as_array(): json is not an array"));
     }
-    return operator[](static_cast<size_t>(index));
+    return *pointer<_array>();
 }
 
-json& json::operator[](size_t index) {
-    if (type != Type::_array) {
-        throw std::runtime_error("At operator[]: json is not an array");
+const _array& json::as_array() const {
+    if (kind() == Kind::shared_array) {
+        return pointer<shared_rep<_array>>()->value;
     }
-    if (index >= std::get<_array>(data).size()) {
-        throw std::runtime_error("At operator[]: index out of range");
+    if (kind() != Kind::array) {
+        MYJSON_THROW(std::runtime_error("At as_array(): json is not an array"));
     }
-    return std::get<_array>(data)[index];
+    return *pointer<_array>();
 }
 
-json json::operator[](const std::string& key) const {
-    if (type != Type::_object) {
-        throw std::runtime_error("At operator[]: json is not an object");
+_object& json::as_object() {
+    if (kind() == Kind::shared_object) {
+        unshare();
+        return pointer<shared_rep<_object>>()->value;
+    }
+    if (kind() != Kind::object) {
+        MYJSON_THROW(
+            std::runtime_error("At as_object(): json is not an object"));
     }
-    return std::get<_object>(data).at(key);
+    return *pointer<_object>();
 }
 
-json json::operator[](const char* key) const {
-    return operator[](std::string(key));
+const _object& json::as_object() const {
+    if (kind() == Kind::shared_object) {
+        return pointer<shared_rep<_object>>()->value;
+    }
+    if (kind() != Kind::object) {
+        MYJSON_THROW(
+            std::runtime_error("At as_object(): json is not an object"));
+    }
+    return *pointer<_object>();
 }
 
-json json::operator[](int index) const {
-    if (index < 0) {
-        throw std::runtime_error("At operator[]: index is negative");
+json* json::find(std::string_view key) {
+    if (get_type() != Type::_object) {
+        return nullptr;
     }
-    return operator[](static_cast<size_t>(index));
+    _object& obj = as_object();
+    auto it = obj.find(key);
+    return it == obj.end() ? nullptr : &it->second;
 }
 
-json json::operator[](size_t index) const {
-    if (type != Type::_array) {
-        throw std::runtime_error("At operator[]: json is not an array");
+const json* json::find(std::string_view key) const {
+    if (get_type() != Type::_object) {
+        return nullptr;
     }
-    if (index >= std::get<_array>(data).size()) {
-        throw std::runtime_error("At operator[]: index out of range");
-    }
-    return std::get<_array>(data).at(index);
+    const _object& obj = as_object();
+    auto it = obj.find(key);
+    return it == obj.end() ? nullptr : &it->second;
 }
 
-template <class T>
-json& json::operator=(const T& value) {
-    to_json(*this, value);
-    return *this;
+bool json::contains(std::string_view key) const {
+    return find(key) != nullptr;
 }
 
-json& json::operator=(const json& other) {
-    type = other.type;
-    data = other.data;
-    return *this;
+template <class T>
+auto json::get() const -> T {
+    // T() where from_json() leaves it unchanged, for another json type or
+    // a number out of range
+    T result{};
+    from_json(*this, result);
+    return result;
 }
 
-json& json::operator=(json&& other) {
-    type = other.type;
-    data = std::move(other.data);
-    return *this;
+template <class T>
+void json::get_to(T& value) const {
+    from_json(*this, value);
 }
 
-// operator overloading
-std::ostream& operator<<(std::ostream& os, const json& j) {
-    os << j.dump();
-    return os;
+auto json::to_array() const -> const _array& {
+    if (get_type() == Type::_array) {
+        return as_array();
+    } else {
+        MYJSON_THROW(std::runtime_error("At to_array(): json is not an array"));
+    }
 }
 
-bool operator==(const json& lhs, const json& rhs) {
-    if (lhs.type == rhs.type && lhs.data == rhs.data) {
-        return true;
+auto json::to_map() const -> const _object& {
+    if (get_type() == Type::_object) {
+        return as_object();
     } else {
-        return false;
+        MYJSON_THROW(std::runtime_error("At to_map(): json is not an object"));
     }
 }
 
-bool operator!=(const json& lhs, const json& rhs) { return !(lhs == rhs); }
+// Modifiers
+void json::push(const json& value) {
+    if (get_type() == Type::_array) {
+        as_array().push_back(value);
+    } else {
+        MYJSON_THROW(std::runtime_error("At push(): json is not an array"));
+    }
+}
 
-// Conversion functions
-std::string json::dump() const {
-    std::string result;
-    if (type == Type::_null) {
-        result = "null";
-    } else if (type == Type::_bool) {
-        result = std::get<_bool>(data) ? "true" : "false";
-    } else if (type == Type::_int) {
-        result = std::to_string(std::get<_int>(data));
-    } else if (type == Type::_float) {
-        result = std::to_string(std::get<_float>(data));
-    } else if (type == Type::_string) {
-        result = "\"" + std::get<_string>(data) + "\"";
-    } else if (type == Type::_array) {
-        result = "[";
-        for (size_t i = 0; i < std::get<_array>(data).size(); ++i) {
-            result += std::get<_array>(data)[i].dump();
-            if (i != std::get<_array>(data).size() - 1) {
-                result += ", ";
-            }
-        }
-        result += "]";
-    } else if (type == Type::_object) {
-        result = "{";
-        for (auto it = std::get<_object>(data).begin();
-             it != std::get<_object>(data).end(); ++it) {
-            result += "\"" + it->first + "\": " + it->second.dump();
-            if (it != --std::get<_object>(data).end()) {
-                result += ", ";
-            }
-        }
-        result += "}";
+void json::push(json&& value) {
+    if (get_type() == Type::_array) {
+        as_array().push_back(std::move(value));
     } else {
-        result = "Unknown type";
+        MYJSON_THROW(std::runtime_error("At push(): json is not an array"));
     }
-    return result;
 }
 
-// out of class and parse function
-std::string remove_unwanted_whitespace(const std::string& str) {
-    std::string result;
-    bool inside_quotes = false;
+// the element is built first, then moved or copied into the array's
+// memory resource
+template <class... Args>
+json& json::emplace_back(Args&&... args) {
+    if (get_type() != Type::_array) {
+        MYJSON_THROW(
+            std::runtime_error("At emplace_back(): json is not an array"));
+    }
+    return as_array().emplace_back(json(std::forward<Args>(args)...));
+}
 
-    for (size_t i = 0; i < str.size(); ++i) {
-        char current_char = str[i];
-        // if current character is a quote, toggle whether we are inside quotes
-        if (current_char == '\"') {
-            inside_quotes = !inside_quotes;
-            result += current_char;
-        } else if (inside_quotes ||
-                   !isspace(static_cast<unsigned char>(current_char))) {
-            // inside quotes or current character is not a space
-            result += current_char;
-        } else if (current_char == ' ' && !inside_quotes) {
-            result += "";
-        }
+template <class... Args>
+json& json::emplace(std::string_view key, Args&&... args) {
+    if (get_type() != Type::_object) {
+        MYJSON_THROW(std::runtime_error("At emplace(): json is not an object"));
     }
-    return result;
+    _object& obj = as_object();
+    auto it = obj.find(key);
+    if (it == obj.end()) {
+        it = obj.emplace(key, json(std::forward<Args>(args)...)).first;
+    }
+    return it->second;
 }
 
-std::string remove_whitespace(const std::string& str) {
-    return remove_unwanted_whitespace(str);
+void json::pop() {
+    if (get_type() == Type::_array) {
+        as_array().pop_back();
+    } else {
+        MYJSON_THROW(std::runtime_error("At pop(): json is not an array"));
+    }
 }
 
-std::string code_point_to_utf8(char32_t code_point) {
-    if (code_point <= 0x7F) {
-        return std::string(1, static_cast<char>(code_point));
-    } else if (code_point <= 0x7FF) {
-        return std::string{static_cast<char>(0xC0 | ((code_point >> 6) & 0x1F)),
-                           static_cast<char>(0x80 | (code_point & 0x3F))};
-    } else if (code_point <= 0xFFFF) {
-        return std::string{
-            static_cast<char>(0xE0 | ((code_point >> 12) & 0x0F)),
-            static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)),
-            static_cast<char>(0x80 | (code_point & 0x3F))};
+void json::remove(std::string_view key) {
+    if (get_type() == Type::_object) {
+        _object& obj = as_object();
+        auto it = obj.find(key);
+        if (it != obj.end()) {
+            obj.erase(it);
+        }
     } else {
-        return std::string{
-            static_cast<char>(0xF0 | ((code_point >> 18) & 0x07)),
-            static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)),
-            static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)),
-            static_cast<char>(0x80 | (code_point & 0x3F))};
+        MYJSON_THROW(std::runtime_error("At remove(): json is not an object"));
     }
 }
 
-std::string& cvt_escape_char(std::string& str) {
-    std::regex re("\\\\u[0-9a-fA-F]{4}");
-    std::smatch match;
-    while (std::regex_search(str, match, re)) {
-        std::string code_point_str = match.str().substr(2);
-        try {
-            char32_t code_point = std::stoul(code_point_str, nullptr, 16);
-            std::string utf8_str = code_point_to_utf8(code_point);
-            str.replace(match.position(), match.length(), utf8_str);
-        } catch (const std::exception& e) {
-            throw std::runtime_error(
-                "At cvt_escape_char(): invalid escape character");
+void json::reserve(size_t n) {
+    if (get_type() == Type::_array) {
+        as_array().reserve(n);
+    } else if (get_type() == Type::_object) {
+#if defined(MYJSON_FLAT_OBJECT) || defined(MYJSON_HASH_OBJECT)
+        as_object().reserve(n);
+#endif
+    } else {
+        MYJSON_THROW(std::runtime_error(
+            "At reserve(): json is not an array or object"));
+    }
+}
+
+json json::array(size_t capacity) {
+    _array elements;
+    elements.reserve(capacity);
+    return json(std::move(elements));
+}
+
+// Sharing
+// children are shared first, so moving them into the shared container
+// never copies them
+void json::share() {
+    if (detail::arena_registry::instance().find(this) != nullptr) {
+        MYJSON_THROW(std::runtime_error(
+            "At share(): json is in an arena, share a copy of it"));
+    }
+    share_nodes();
+}
+
+void json::share_nodes() {
+    allocator_type alloc(default_resource());
+    if (kind() == Kind::long_string) {
+        auto rep = make_shared_rep<_string>(
+            _string(std::move(*pointer<_string>()), alloc));
+        destroy();
+        set_pointer(Kind::shared_string, rep);
+    } else if (kind() == Kind::array) {
+        for (json& element : *pointer<_array>()) {
+            element.share_nodes();
+        }
+        auto rep = make_shared_rep<_array>(
+            _array(std::move(*pointer<_array>()), alloc));
+        destroy();
+        set_pointer(Kind::shared_array, rep);
+    } else if (kind() == Kind::object) {
+        for (auto& member : *pointer<_object>()) {
+            member.second.share_nodes();
+        }
+        auto rep = make_shared_rep<_object>(
+            _object(std::move(*pointer<_object>()), alloc));
+        destroy();
+        set_pointer(Kind::shared_object, rep);
+    } else if (kind() == Kind::shared_array) {
+        // values written since the last share() are below storage only this
+        // node refers to, storage other nodes can see is left alone
+        auto rep = pointer<shared_rep<_array>>();
+        if (rep->references.load(std::memory_order_acquire) == 1) {
+            for (json& element : rep->value) {
+                element.share_nodes();
+            }
+        }
+    } else if (kind() == Kind::shared_object) {
+        auto rep = pointer<shared_rep<_object>>();
+        if (rep->references.load(std::memory_order_acquire) == 1) {
+            for (auto& member : rep->value) {
+                member.second.share_nodes();
+            }
         }
     }
-    return str;
 }
 
-json parse(const std::string& str, size_t& index);
+bool json::is_shared() const {
+    return kind() == Kind::shared_string || kind() == Kind::shared_array ||
+           kind() == Kind::shared_object;
+}
+
+// Operators
+json& json::operator[](std::string_view key) {
+    if (get_type() != Type::_object) {
+        MYJSON_THROW(
+            std::runtime_error("At operator[]: json is not an object"));
+    }
+    // a key is only copied when it is inserted
+    _object& obj = as_object();
+    auto it = obj.find(key);
+    if (it == obj.end()) {
+        it = obj.emplace(key, json()).first;
+    }
+    return it->second;
+}
+
+json& json::operator[](const std::string& key) {
+    return operator[](std::string_view(key));
+}
+
+json& json::operator[](const char* key) {
+    return operator[](std::string_view(key));
+}
+
+json& json::operator[](int index) {
+    if (index < 0) {
+        MYJSON_THROW(std::runtime_error("At operator[]: index is negative"));
+    }
+    return operator[](static_cast<size_t>(index));
+}
+
+json& json::operator[](size_t index) {
+    if (get_type() != Type::_array) {
+        MYJSON_THROW(std::runtime_error("At operator[]: json is not an array"));
+    }
+    if (index >= as_array().size()) {
+        MYJSON_THROW(std::runtime_error("At operator[]: index out of range"));
+    }
+    return as_array()[index];
+}
+
+const json& json::operator[](std::string_view key) const {
+    if (get_type() != Type::_object) {
+        MYJSON_THROW(
+            std::runtime_error("At operator[]: json is not an object"));
+    }
+    const _object& obj = as_object();
+    auto it = obj.find(key);
+    if (it == obj.end()) {
+        MYJSON_THROW(std::out_of_range("At operator[]: key not found"));
+    }
+    return it->second;
+}
+
+const json& json::operator[](const std::string& key) const {
+    return operator[](std::string_view(key));
+}
+
+const json& json::operator[](const char* key) const {
+    return operator[](std::string_view(key));
+}
+
+const json& json::operator[](int index) const {
+    if (index < 0) {
+        MYJSON_THROW(std::runtime_error("At operator[]: index is negative"));
+    }
+    return operator[](static_cast<size_t>(index));
+}
+
+const json& json::operator[](size_t index) const {
+    if (get_type() != Type::_array) {
+        MYJSON_THROW(std::runtime_error("At operator[]: json is not an array"));
+    }
+    if (index >= as_array().size()) {
+        MYJSON_THROW(std::runtime_error("At operator[]: index out of range"));
+    }
+    return as_array().at(index);
+}
+
+template <class T>
+json& json::operator=(const T& value) {
+    to_json(*this, value);
+    return *this;
+}
+
+json& json::operator=(const json& other) {
+    if (this != &other) {
+        // a container keeps allocating from the resource it had
+        json copy(other, allocator_type(target_resource(other)));
+        destroy();
+        take(copy);
+    }
+    return *this;
+}
 
-json parse_null(const std::string& str, size_t& index) {
-    if (str.substr(index, 4) == "null") {
-        index += 4;
-        return json();
+json& json::operator=(json&& other) {
+    std::pmr::memory_resource* target = target_resource(other);
+    if (this == &other) {
+        return *this;
+    } else if (target != default_resource() && other.resource() != target) {
+        json copy(std::move(other), allocator_type(target));
+        destroy();
+        take(copy);
     } else {
-        throw std::runtime_error("At parse_null(): invalid null value");
+        destroy();
+        take(other);
     }
+    return *this;
+}
+
+json& json::operator=(_string&& value) {
+    return operator=(json(std::move(value)));
+}
+
+json& json::operator=(_array&& value) {
+    return operator=(json(std::move(value)));
+}
+
+json& json::operator=(_object&& value) {
+    return operator=(json(std::move(value)));
+}
+
+// operator overloading
+std::ostream& operator<<(std::ostream& os, const json& j) {
+    j.dump_to(os);
+    return os;
 }
 
-json parse_true(const std::string& str, size_t& index) {
-    if (str.substr(index, 4) == "true") {
-        index += 4;
-        return json(true);
+bool operator==(const json& lhs, const json& rhs) {
+    json::Type type = lhs.get_type();
+    if (type != rhs.get_type()) {
+        return false;
+    }
+    if (type == json::Type::_null) {
+        return true;
+    } else if (type == json::Type::_bool) {
+        return lhs.as_bool() == rhs.as_bool();
+    } else if (type == json::Type::_int) {
+        return lhs.as_int() == rhs.as_int();
+    } else if (type == json::Type::_float) {
+        return lhs.as_float() == rhs.as_float();
+    } else if (type == json::Type::_string) {
+        // inline, out-of-line and zero-copy strings compare by content
+        return lhs.get_string_view() == rhs.get_string_view();
+    } else if (type == json::Type::_array) {
+        return lhs.as_array() == rhs.as_array();
     } else {
-        throw std::runtime_error("At parse_true(): invalid true value");
+        return lhs.as_object() == rhs.as_object();
     }
 }
 
-json parse_false(const std::string& str, size_t& index) {
-    if (str.substr(index, 5) == "false") {
-        index += 5;
-        return json(false);
+bool operator!=(const json& lhs, const json& rhs) { return !(lhs == rhs); }
+
+// Object keys
+object_key::object_key(std::string_view key, const allocator_type& alloc)
+    : resource(alloc.resource()) {
+    set(key);
+}
+
+object_key::object_key(const object_key& other, const allocator_type& alloc)
+    : resource(alloc.resource()) {
+    set(other.view());
+}
+
+object_key::object_key(object_key&& other) noexcept
+    : resource(other.resource) {
+    take(other);
+}
+
+object_key::object_key(object_key&& other, const allocator_type& alloc)
+    : resource(alloc.resource()) {
+    if (other.kind() != Kind::allocated || other.resource == resource) {
+        take(other);
     } else {
-        throw std::runtime_error("At parse_false(): invalid false value");
+        set(other.view());
     }
 }
 
-json parse_string(const std::string& str, size_t& index) {
-    try {
-        size_t start = index + 1;
-        size_t end = str.find('\"', start);
-        index = end + 1;
-        std::string result = str.substr(start, end - start);
-        cvt_escape_char(result);
-        return json(result);
-    } catch (std::exception& e) {
-        throw std::runtime_error("At parse_string(): invalid string value");
+object_key& object_key::operator=(const object_key& other) {
+    if (this != &other) {
+        destroy();
+        set(other.view());
+    }
+    return *this;
+}
+
+object_key& object_key::operator=(object_key&& other) {
+    if (this == &other) {
+        return *this;
+    }
+    destroy();
+    if (other.kind() != Kind::allocated || other.resource == resource) {
+        take(other);
+    } else {
+        set(other.view());
     }
+    return *this;
 }
 
-json parse_array(const std::string& str, size_t& index) {
-    try {
-        _array arr;
-        index++;
-        while (str[index] != ']') {
-            arr.push_back(parse(str, index));
-            if (str[index] == ',') {
-                index++;
-            }
+object_key object_key::shared(std::string_view interned) {
+    object_key key{std::string_view()};
+    if (interned.size() <= inline_capacity) {
+        key.set(interned);
+        return key;
+    }
+    const char* data = interned.data();
+    uint32_t size = static_cast<uint32_t>(interned.size());
+    std::memcpy(key.bytes, &data, sizeof(data));
+    std::memcpy(key.bytes + 8, &size, sizeof(size));
+    key.bytes[15] = static_cast<unsigned char>(Kind::shared);
+    return key;
+}
+
+std::string_view object_key::view() const {
+    if (kind() == Kind::inline_chars) {
+        return std::string_view(reinterpret_cast<const char*>(bytes),
+                                bytes[14]);
+    }
+    const char* data;
+    uint32_t size;
+    std::memcpy(&data, bytes, sizeof(data));
+    std::memcpy(&size, bytes + 8, sizeof(size));
+    return std::string_view(data, size);
+}
+
+void object_key::set(std::string_view key) {
+    if (key.size() <= inline_capacity) {
+        if (!key.empty()) {
+            std::memcpy(bytes, key.data(), key.size());
         }
-        index++;
-        return json(arr);
-    } catch (std::exception& e) {
-        throw std::runtime_error("At parse_array(): invalid array value");
+        bytes[14] = static_cast<unsigned char>(key.size());
+        bytes[15] = static_cast<unsigned char>(Kind::inline_chars);
+        return;
+    }
+    if (key.size() > UINT32_MAX) {
+        MYJSON_THROW(std::length_error("At object_key(): key is too long"));
     }
+    char* data = static_cast<char*>(resource->allocate(key.size(), 1));
+    std::memcpy(data, key.data(), key.size());
+    uint32_t size = static_cast<uint32_t>(key.size());
+    std::memcpy(bytes, &data, sizeof(data));
+    std::memcpy(bytes + 8, &size, sizeof(size));
+    bytes[15] = static_cast<unsigned char>(Kind::allocated);
 }
 
-json parse_object(const std::string& str, size_t& index) {
-    try {
-        _object obj;
-        index++;
-        while (str[index] != '}') {
-            std::string key =
-                std::get<std::string>(parse(str, index).get_data());
-            index++;
-            obj[key] = parse(str, index);
-            if (str[index] == ',') {
-                index++;
+// other must own its characters in resource, or not allocate them at all
+void object_key::take(object_key& other) noexcept {
+    std::memcpy(bytes, other.bytes, sizeof(bytes));
+    other.bytes[14] = 0;
+    other.bytes[15] = static_cast<unsigned char>(Kind::inline_chars);
+}
+
+void object_key::destroy() noexcept {
+    if (kind() == Kind::allocated) {
+        std::string_view key = view();
+        resource->deallocate(const_cast<char*>(key.data()), key.size(), 1);
+    }
+    bytes[14] = 0;
+    bytes[15] = static_cast<unsigned char>(Kind::inline_chars);
+}
+
+// Key interning
+std::string_view key_table::intern(std::string_view key) {
+    if (2 * (count + 1) > slots.size()) {
+        grow();
+    }
+    size_t mask = slots.size() - 1;
+    size_t slot = std::hash<std::string_view>()(key) & mask;
+    while (slots[slot].data() != nullptr) {
+        if (slots[slot] == key) {
+            return slots[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    // one byte for an empty key, so that its slot is not empty
+    char* data =
+        static_cast<char*>(resource->allocate(std::max<size_t>(key.size(), 1),
+                                              1));
+    std::memcpy(data, key.data(), key.size());
+    slots[slot] = std::string_view(data, key.size());
+    count++;
+    return slots[slot];
+}
+
+void key_table::clear() {
+    for (std::string_view key : slots) {
+        if (key.data() != nullptr) {
+            resource->deallocate(const_cast<char*>(key.data()),
+                                 std::max<size_t>(key.size(), 1), 1);
+        }
+    }
+    slots.clear();
+    count = 0;
+}
+
+void key_table::grow() {
+    std::pmr::vector<std::string_view> old(resource);
+    old.swap(slots);
+    slots.assign(std::max<size_t>(64, 2 * old.size()), std::string_view());
+    size_t mask = slots.size() - 1;
+    for (std::string_view key : old) {
+        if (key.data() != nullptr) {
+            size_t slot = std::hash<std::string_view>()(key) & mask;
+            while (slots[slot].data() != nullptr) {
+                slot = (slot + 1) & mask;
             }
+            slots[slot] = key;
         }
-        index++;
-        return json(obj);
-    } catch (std::exception& e) {
-        throw std::runtime_error("At parse_object(): invalid object value");
     }
 }
 
-json parse_number(const std::string& str, size_t& index) {
-    try {
-        size_t start = index;
-        bool has_dot = false;
-        bool has_exp = false;
-        while (std::isdigit(str[index]) || str[index] == '.' ||
-               str[index] == 'e' || str[index] == 'E' || str[index] == '+' ||
-               str[index] == '-') {
-            if (str[index] == '.') {
-                has_dot = true;
-            }
-            if (str[index] == 'e' || str[index] == 'E') {
-                has_exp = true;
+// Object storage backends
+flat_object::iterator flat_object::find(std::string_view key) {
+    return std::find_if(items.begin(), items.end(),
+                        [key](const value_type& item) {
+                            return item.first.equals(key);
+                        });
+}
+
+flat_object::const_iterator flat_object::find(std::string_view key) const {
+    return std::find_if(items.begin(), items.end(),
+                        [key](const value_type& item) {
+                            return item.first.equals(key);
+                        });
+}
+
+std::pair<flat_object::iterator, bool> flat_object::emplace(
+    std::string_view key, json&& value) {
+    iterator it = find(key);
+    if (it != items.end()) {
+        return {it, false};
+    }
+    items.emplace_back(key, std::move(value));
+    return {items.end() - 1, true};
+}
+
+std::pair<flat_object::iterator, bool> flat_object::emplace(
+    object_key&& key, json&& value) {
+    iterator it = find(key.view());
+    if (it != items.end()) {
+        return {it, false};
+    }
+    items.emplace_back(std::move(key), std::move(value));
+    return {items.end() - 1, true};
+}
+
+bool operator==(const flat_object& lhs, const flat_object& rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (const auto& item : lhs) {
+        auto it = rhs.find(item.first);
+        if (it == rhs.end() || it->second != item.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t hash_object::find_index(std::string_view key) const {
+    if (slots.empty()) {
+        for (size_t i = 0; i < entries.size(); i++) {
+            if (entries[i].first.equals(key)) {
+                return i;
             }
-            index++;
         }
-        if (has_dot || has_exp) {
-            return json(std::stod(str.substr(start, index - start)));
+        return entries.size();
+    }
+    size_t mask = slots.size() - 1;
+    size_t slot = std::hash<std::string_view>()(key) & mask;
+    while (slots[slot] != 0) {
+        size_t index = slots[slot] - 1;
+        if (entries[index].first.equals(key)) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return entries.size();
+}
+
+void hash_object::insert_slot(size_t index) {
+    size_t mask = slots.size() - 1;
+    std::string_view key = entries[index].first;
+    size_t slot = std::hash<std::string_view>()(key) & mask;
+    while (slots[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    slots[slot] = static_cast<uint32_t>(index + 1);
+}
+
+void hash_object::rebuild_index() {
+    slots.clear();
+    if (entries.size() <= index_threshold) {
+        return;
+    }
+    // keep the load factor at or below one half
+    size_t capacity = 2 * index_threshold;
+    while (capacity < 2 * entries.size()) {
+        capacity *= 2;
+    }
+    slots.assign(capacity, 0);
+    for (size_t i = 0; i < entries.size(); i++) {
+        insert_slot(i);
+    }
+}
+
+hash_object::iterator hash_object::find(std::string_view key) {
+    return entries.begin() + find_index(key);
+}
+
+hash_object::const_iterator hash_object::find(std::string_view key) const {
+    return entries.begin() + find_index(key);
+}
+
+std::pair<hash_object::iterator, bool> hash_object::emplace(
+    std::string_view key, json&& value) {
+    size_t index = find_index(key);
+    if (index != entries.size()) {
+        return {entries.begin() + index, false};
+    }
+    entries.emplace_back(key, std::move(value));
+    index_entry(index);
+    return {entries.end() - 1, true};
+}
+
+std::pair<hash_object::iterator, bool> hash_object::emplace(
+    object_key&& key, json&& value) {
+    size_t index = find_index(key.view());
+    if (index != entries.size()) {
+        return {entries.begin() + index, false};
+    }
+    entries.emplace_back(std::move(key), std::move(value));
+    index_entry(index);
+    return {entries.end() - 1, true};
+}
+
+// after appending entries[index]
+void hash_object::index_entry(size_t index) {
+    if (entries.size() > index_threshold) {
+        if (slots.size() < 2 * entries.size()) {
+            rebuild_index();
+        } else {
+            insert_slot(index);
+        }
+    }
+}
+
+hash_object::iterator hash_object::erase(const_iterator it) {
+    iterator next = entries.erase(it);
+    size_t index = next - entries.begin();
+    rebuild_index();
+    return entries.begin() + index;
+}
+
+bool operator==(const hash_object& lhs, const hash_object& rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (const auto& entry : lhs) {
+        auto it = rhs.find(entry.first);
+        if (it == rhs.end() || it->second != entry.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// String escape helpers
+// append the utf-8 encoding of code_point to out
+template <class String>
+void append_utf8(String& out, char32_t code_point) {
+    if (code_point <= 0x7F) {
+        out += static_cast<char>(code_point);
+    } else if (code_point <= 0x7FF) {
+        out += static_cast<char>(0xC0 | ((code_point >> 6) & 0x1F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else if (code_point <= 0xFFFF) {
+        out += static_cast<char>(0xE0 | ((code_point >> 12) & 0x0F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | ((code_point >> 18) & 0x07));
+        out += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+std::string code_point_to_utf8(char32_t code_point) {
+    std::string result;
+    append_utf8(result, code_point);
+    return result;
+}
+
+// value of the 4 hex digits at str[pos], -1 if they are not hex digits
+int32_t decode_hex4(std::string_view str, size_t pos) {
+    if (pos + 4 > str.size()) {
+        return -1;
+    }
+    int32_t value = 0;
+    for (size_t i = pos; i < pos + 4; ++i) {
+        char c = str[i];
+        value <<= 4;
+        if (c >= '0' && c <= '9') {
+            value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            value |= c - 'A' + 10;
         } else {
-            try {
-                int64_t num = std::stoll(str.substr(start, index - start));
-                return json(num);
-            } catch (const std::exception& e) {
-                throw std::runtime_error("At parse_number(): stoll error");
+            return -1;
+        }
+    }
+    return value;
+}
+
+// decode the escape sequences of a json string body (without quotes) into
+// out in a single pass, out never grows past str.size(). Returns the offset
+// of the first invalid escape, or npos if str was decoded completely.
+template <class String>
+size_t try_unescape_string(std::string_view str, String& out) {
+    out.clear();
+    const char* first = str.data();
+    const char* last = str.data() + str.size();
+    const char* backslash = static_cast<const char*>(
+        std::memchr(first, '\\', str.size()));
+    if (backslash == nullptr) {
+        // fast path: nothing to decode
+        out.assign(first, str.size());
+        return std::string_view::npos;
+    }
+    MYJSON_STATS_TIME(unescape_ns);
+    out.reserve(str.size());
+    while (backslash != nullptr) {
+        out.append(first, backslash);
+        size_t escape = backslash - str.data();
+        size_t pos = escape + 1;
+        if (pos >= str.size()) {
+            return escape;
+        }
+        switch (str[pos]) {
+            case '\"': out += '\"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                int32_t code_point = decode_hex4(str, pos + 1);
+                pos += 4;
+                if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+                    // high surrogate, must be followed by \u low surrogate
+                    int32_t low = -1;
+                    if (pos + 2 < str.size() && str[pos + 1] == '\\' &&
+                        str[pos + 2] == 'u') {
+                        low = decode_hex4(str, pos + 3);
+                    }
+                    if (low < 0xDC00 || low > 0xDFFF) {
+                        return escape;
+                    }
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) +
+                                 (low - 0xDC00);
+                    pos += 6;
+                } else if (code_point < 0 ||
+                           (code_point >= 0xDC00 && code_point <= 0xDFFF)) {
+                    return escape;
+                }
+                append_utf8(out, static_cast<char32_t>(code_point));
+                break;
             }
+            default:
+                return escape;
         }
+        first = str.data() + pos + 1;
+        backslash = static_cast<const char*>(
+            std::memchr(first, '\\', last - first));
+    }
+    out.append(first, last);
+    return std::string_view::npos;
+}
 
-        return json(std::stod(str.substr(start, index - start)));
-    } catch (const std::exception& e) {
-        throw std::runtime_error("At parse_number(): invalid number value");
+// same as try_unescape_string(), but throws on an invalid escape
+template <class String>
+void unescape_string(std::string_view str, String& out) {
+    if (try_unescape_string(str, out) != std::string_view::npos) {
+        MYJSON_THROW(std::runtime_error(
+            "At unescape_string(): invalid escape character"));
     }
 }
 
-// json parse_escape(const std::string& str, size_t& index) {
+// decode all escape sequences of str in place
+std::string& cvt_escape_char(std::string& str) {
+    if (str.find('\\') == std::string::npos) {
+        return str;
+    }
+    std::string result;
+    unescape_string(str, result);
+    str.swap(result);
+    return str;
+}
+
+// append str to out with quotes and the characters json requires escaped
+void escape_string(std::string_view str, std::string& out) {
+    static const char hex[] = "0123456789abcdef";
+    out += '\"';
+    size_t first = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        if (c >= 0x20 && c != '\"' && c != '\\') {
+            continue;
+        }
+        out.append(str.data() + first, i - first);
+        first = i + 1;
+        switch (c) {
+            case '\"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+        }
+    }
+    out.append(str.data() + first, str.size() - first);
+    out += '\"';
+}
 
-// }
+// Number format helpers
+// append the decimal digits of value to out
+void append_int(std::string& out, _int value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
 
-json parse(const std::string& str, size_t& index) {
-    try {
-        if (str[index] == 'n') {
-            return parse_null(str, index);
-        } else if (str[index] == 't') {
-            return parse_true(str, index);
-        } else if (str[index] == 'f') {
-            return parse_false(str, index);
-        } else if (str[index] == '\"') {
-            return parse_string(str, index);
-        } else if (str[index] == '[') {
-            return parse_array(str, index);
-        } else if (str[index] == '{') {
-            return parse_object(str, index);
-        } else if (std::isdigit(str[index]) || str[index] == '-') {
-            return parse_number(str, index);
-            // } else if (str[index] == '\\') {
-            //     return parse_escape(str, index);
-        } else {
-            throw std::runtime_error("Error: Unknown character");
-        }
-    } catch (std::exception& e) {
-        throw std::runtime_error(
-            "Error: invalid JSON string in parse() at position " +
-            std::to_string(index) + "\n" + e.what());
-    }
-    return json();
-}
-
-json parse(const std::string& str) {
-    if (str.empty()) {
-        return json();
+// append the shortest text that parses back to the same double, with a
+// '.0' suffix for whole numbers so they stay floats after a roundtrip
+void append_float(std::string& out, _float value) {
+    if (!std::isfinite(value)) {
+        // json has no inf or nan
+        out += "null";
+        return;
+    }
+    char buffer[32];
+#if defined(__cpp_lib_to_chars)
+    char* end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+#else
+    char* end = buffer + std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+#endif
+    out.append(buffer, end);
+    if (std::find_if(buffer, end, [](char c) {
+            return c == '.' || c == 'e' || c == 'E';
+        }) == end) {
+        out += ".0";
     }
-    std::string json_str = remove_whitespace(str);
-    size_t index = 0;
-    return parse(json_str, index);
 }
 
-json parse(const char* str) { return parse(std::string(str)); }
+namespace detail {
+
+// appends to a string and, when there is a sink, hands it every full chunk
+struct dump_writer {
+    static constexpr size_t chunk_size = 16384;
+
+    std::string& out;
+    output_sink* sink;
+
+    void flush_if_full() {
+        if (sink != nullptr && out.size() >= chunk_size) {
+            MYJSON_STATS_ADD(bytes_scanned, out.size());
+            sink->write(out.data(), out.size());
+            out.clear();
+        }
+    }
+};
+
+// a scalar or an empty array or object
+void dump_leaf(const json& j, std::string& out) {
+    json::Type type = j.get_type();
+    if (type == json::Type::_null) {
+        MYJSON_STATS_ADD(nulls, 1);
+        out += "null";
+    } else if (type == json::Type::_bool) {
+        MYJSON_STATS_ADD(bools, 1);
+        out += j.as_bool() ? "true" : "false";
+    } else if (type == json::Type::_int) {
+        MYJSON_STATS_ADD(ints, 1);
+        append_int(out, j.as_int());
+    } else if (type == json::Type::_float) {
+        MYJSON_STATS_ADD(floats, 1);
+        append_float(out, j.as_float());
+    } else if (type == json::Type::_string) {
+        MYJSON_STATS_ADD(strings, 1);
+        escape_string(j.get_string_view(), out);
+    } else if (type == json::Type::_array) {
+        MYJSON_STATS_ADD(arrays, 1);
+        out += "[]";
+    } else if (type == json::Type::_object) {
+        MYJSON_STATS_ADD(objects, 1);
+        out += "{}";
+    }
+}
+
+// an array or object being written and its current element
+struct dump_frame {
+    const json* container;
+    size_t index;
+    _object::const_iterator member;
+};
+
+// open containers are kept on an explicit stack, so any nesting depth is
+// written with constant call stack
+void dump_value(const json& root, dump_writer& writer,
+                const dump_options& options) {
+    std::string& out = writer.out;
+    const char* comma = options.compact ? "," : ", ";
+    const char* colon = options.compact ? ":" : ": ";
+    std::vector<dump_frame> stack;
+    const json* next = &root;
+    while (true) {
+        // descend to the first leaf of next
+        while (true) {
+            json::Type type = next->get_type();
+            if (type == json::Type::_array && !next->as_array().empty()) {
+                MYJSON_STATS_ADD(arrays, 1);
+                out += '[';
+                stack.push_back({next, 0, _object::const_iterator()});
+                next = &next->as_array()[0];
+            } else if (type == json::Type::_object &&
+                       !next->as_object().empty()) {
+                MYJSON_STATS_ADD(objects, 1);
+                MYJSON_STATS_ADD(keys, next->as_object().size());
+                auto it = next->as_object().begin();
+                out += '{';
+                escape_string(it->first, out);
+                out += colon;
+                stack.push_back({next, 0, it});
+                next = &it->second;
+            } else {
+                dump_leaf(*next, out);
+                // an empty array or object is a level of its own
+                MYJSON_STATS_DEPTH(stack.size() +
+                                   (next->get_type() == json::Type::_array ||
+                                    next->get_type() == json::Type::_object));
+                break;
+            }
+        }
+        // close the containers that end here, up to the next sibling
+        while (true) {
+            if (stack.empty()) {
+                return;
+            }
+            writer.flush_if_full();
+            dump_frame& top = stack.back();
+            if (top.container->get_type() == json::Type::_array) {
+                const _array& arr = top.container->as_array();
+                if (++top.index < arr.size()) {
+                    out += comma;
+                    next = &arr[top.index];
+                    break;
+                }
+                out += ']';
+            } else {
+                const _object& obj = top.container->as_object();
+                if (++top.member != obj.end()) {
+                    out += comma;
+                    escape_string(top.member->first, out);
+                    out += colon;
+                    next = &top.member->second;
+                    break;
+                }
+                out += '}';
+            }
+            stack.pop_back();
+        }
+    }
+}
+
+}  // namespace detail
+
+// Conversion functions
+std::string json::dump(const dump_options& options) const {
+    std::string result;
+    dump_to(result, options);
+    return result;
+}
+
+void json::dump_to(std::string& out, const dump_options& options) const {
+    MYJSON_STATS_SCOPE(stats_operation::dump);
+    size_t start = out.size();
+    detail::dump_writer writer{out, nullptr};
+    detail::dump_value(*this, writer, options);
+    MYJSON_STATS_ADD(bytes_scanned, out.size() - start);
+}
+
+void json::dump_to(std::ostream& os, const dump_options& options) const {
+    ostream_sink sink(os);
+    dump_to(sink, options);
+}
+
+void json::dump_to(output_sink& sink, const dump_options& options) const {
+    MYJSON_STATS_SCOPE(stats_operation::dump);
+    std::string buffer;
+    buffer.reserve(detail::dump_writer::chunk_size * 2);
+    detail::dump_writer writer{buffer, &sink};
+    detail::dump_value(*this, writer, options);
+    if (!buffer.empty()) {
+        MYJSON_STATS_ADD(bytes_scanned, buffer.size());
+        sink.write(buffer.data(), buffer.size());
+    }
+}
+
+// out of class and parse function
+std::string remove_unwanted_whitespace(const std::string& str) {
+    std::string result;
+    result.reserve(str.size());
+    bool inside_quotes = false;
+    bool escaped = false;
+
+    for (size_t i = 0; i < str.size(); ++i) {
+        char current_char = str[i];
+        if (inside_quotes) {
+            // keep everything inside quotes, an escaped quote does not close
+            // the string
+            if (escaped) {
+                escaped = false;
+            } else if (current_char == '\\') {
+                escaped = true;
+            } else if (current_char == '\"') {
+                inside_quotes = false;
+            }
+            result += current_char;
+        } else if (current_char == '\"') {
+            inside_quotes = true;
+            result += current_char;
+        } else if (!isspace(static_cast<unsigned char>(current_char))) {
+            result += current_char;
+        }
+    }
+    return result;
+}
+
+// not used by parse() anymore, whitespace is skipped while parsing
+std::string remove_whitespace(const std::string& str) {
+    return remove_unwanted_whitespace(str);
+}
+
+// Parse options
+// nesting limit of parse(), guards against inputs like [[[[... that would
+// otherwise grow the parser's stack without bound
+constexpr size_t default_max_depth = 1024;
+
+struct parse_options {
+    // keep strings without escapes as _string_view slices of the input
+    // instead of copying them, the input must outlive the parsed json
+    bool zero_copy_strings = false;
+    // find all tokens with the SIMD structural scanner first and parse by
+    // walking that index, faster on large documents
+    bool use_structural_index = false;
+    // where strings, arrays and objects are allocated, the heap if nullptr,
+    // set by parse(str, arena&)
+    std::pmr::memory_resource* resource = nullptr;
+    // most arrays and objects that may be open at once, deeper input fails
+    // with parse_error::too_deep
+    size_t max_depth = default_max_depth;
+    // store each distinct long object key once in the arena's key_table,
+    // repeated keys then share it. Only the flat and hash object backends
+    // have shared keys, std::map keys are always copied.
+    bool intern_keys = false;
+    // where keys are interned, set by parse(str, arena&) when intern_keys,
+    // keys are copied if nullptr. The table must outlive the parsed json.
+    key_table* keys = nullptr;
+
+    std::pmr::memory_resource* memory() const {
+        return resource != nullptr ? resource
+                                   : std::pmr::get_default_resource();
+    }
+};
+
+// Parse errors
+enum class parse_error {
+    none,
+    unexpected_end,             // input ended inside a value
+    invalid_value,              // no value starts at this character
+    invalid_literal,            // misspelled null, true or false
+    invalid_number,
+    invalid_escape,             // bad escape sequence in a string
+    expected_key,               // object member does not start with '"'
+    expected_colon,
+    expected_comma_or_bracket,  // after an array element
+    expected_comma_or_brace,    // after an object member
+    too_deep,                   // nested deeper than max_depth
+    input_too_large,            // more than 4 GB for the structural index
+    trailing_characters,        // stream_parser input after the root value
+    cancelled,                  // a sax handler returned false
+    file_error                  // the file could not be read
+};
+
+const char* parse_error_message(parse_error error) {
+    switch (error) {
+        case parse_error::none: return "no error";
+        case parse_error::unexpected_end: return "unexpected end of input";
+        case parse_error::invalid_value: return "expected a value";
+        case parse_error::invalid_literal: return "invalid literal";
+        case parse_error::invalid_number: return "invalid number value";
+        case parse_error::invalid_escape: return "invalid escape character";
+        case parse_error::expected_key: return "expected string key";
+        case parse_error::expected_colon: return "expected ':'";
+        case parse_error::expected_comma_or_bracket:
+            return "expected ',' or ']'";
+        case parse_error::expected_comma_or_brace:
+            return "expected ',' or '}'";
+        case parse_error::too_deep: return "nesting is too deep";
+        case parse_error::input_too_large: return "input is too large";
+        case parse_error::trailing_characters:
+            return "unexpected characters after the value";
+        case parse_error::cancelled: return "cancelled by the sax handler";
+        case parse_error::file_error: return "cannot read the file";
+    }
+    return "unknown error";
+}
+
+// outcome of parse(str, out), converts to true on success
+struct parse_result {
+    parse_error error = parse_error::none;
+    size_t offset = 0;  // byte offset where the error was found
+    size_t line = 1;    // 1-based line and byte column of offset
+    size_t column = 1;
+
+    explicit operator bool() const { return error == parse_error::none; }
+    const char* message() const { return parse_error_message(error); }
+};
+
+// line and column of the error offset, only computed on failure
+parse_result make_parse_result(std::string_view str, parse_error error,
+                               size_t offset) {
+    parse_result result;
+    result.error = error;
+    result.offset = offset;
+    for (size_t i = 0; i < offset && i < str.size(); i++) {
+        if (str[i] == '\n') {
+            result.line++;
+            result.column = 1;
+        } else {
+            result.column++;
+        }
+    }
+    return result;
+}
+
+// message used when parse() throws
+std::string parse_error_string(const parse_result& result) {
+    return "Error: invalid JSON string in parse() at line " +
+           std::to_string(result.line) + ", column " +
+           std::to_string(result.column) + " (position " +
+           std::to_string(result.offset) + ")\n" + result.message();
+}
+
+// Scanning parser
+// Every parse_* token function returns parse_error::none and sets out, or
+// the error with index at the offending byte; nothing here throws.
+// current character, '\0' at the end of input
+char peek(std::string_view str, size_t index) {
+    return index < str.size() ? str[index] : '\0';
+}
+
+// skip whitespace between tokens (space, tab, line feed, carriage return)
+void skip_whitespace(std::string_view str, size_t& index) {
+    while (index < str.size() &&
+           (str[index] == ' ' || str[index] == '\t' || str[index] == '\n' ||
+            str[index] == '\r')) {
+        index++;
+    }
+}
+
+// error at index, or unexpected_end if the input is exhausted there
+parse_error error_at(std::string_view str, size_t index, parse_error error) {
+    return index >= str.size() ? parse_error::unexpected_end : error;
+}
+
+// trailing_characters if anything but whitespace follows the value that
+// ends at index, which is moved to it
+parse_error check_trailing(std::string_view str, size_t& index) {
+    skip_whitespace(str, index);
+    return index < str.size() ? parse_error::trailing_characters
+                              : parse_error::none;
+}
+
+// match word at index, a truncated word is an unexpected end
+parse_error parse_literal(std::string_view str, size_t& index,
+                          std::string_view word) {
+    std::string_view rest = str.substr(index, word.size());
+    if (rest == word) {
+        index += word.size();
+        return parse_error::none;
+    }
+    if (rest.size() < word.size() && word.substr(0, rest.size()) == rest) {
+        index = str.size();
+        return parse_error::unexpected_end;
+    }
+    return parse_error::invalid_literal;
+}
+
+parse_error parse_null(std::string_view str, size_t& index, json& out) {
+    out = json();
+    MYJSON_STATS_ADD(nulls, 1);
+    return parse_literal(str, index, "null");
+}
+
+parse_error parse_true(std::string_view str, size_t& index, json& out) {
+    out = json(true);
+    MYJSON_STATS_ADD(bools, 1);
+    return parse_literal(str, index, "true");
+}
+
+parse_error parse_false(std::string_view str, size_t& index, json& out) {
+    out = json(false);
+    MYJSON_STATS_ADD(bools, 1);
+    return parse_literal(str, index, "false");
+}
+
+// string value of a string token body (without quotes), returns the
+// offset of an invalid escape in body, or npos
+size_t parse_string_body(std::string_view body, bool has_escape,
+                         const parse_options& options, json& out) {
+    if (options.zero_copy_strings && !has_escape) {
+        out = json::make_view(body);
+        return std::string_view::npos;
+    }
+    _string result(options.memory());
+    size_t bad_escape = try_unescape_string(body, result);
+    out = json(std::move(result));
+    return bad_escape;
+}
+
+// the member of obj named key, added as null if it is missing. The key is
+// copied into the object's memory, or shared through keys when it is set
+// and the backend supports it.
+json& member_slot(_object& obj, std::string_view key, key_table* keys) {
+#if defined(MYJSON_FLAT_OBJECT) || defined(MYJSON_HASH_OBJECT)
+    // short keys are stored inline anyway
+    if (keys != nullptr && key.size() > object_key::inline_capacity) {
+        object_key shared = object_key::shared(keys->intern(key));
+        return obj.emplace(std::move(shared), json()).first->second;
+    }
+#else
+    (void)keys;
+#endif
+    auto it = obj.find(key);
+    if (it == obj.end()) {
+        it = obj.emplace(key, json()).first;
+    }
+    return it->second;
+}
+
+// digit value of c, -1 if c is not a digit
+int digit_value(char c) { return (c >= '0' && c <= '9') ? c - '0' : -1; }
+
+// numbers are accumulated in place, without copying the token
+parse_error parse_number(std::string_view str, size_t& index, json& out) {
+    static const double powers_of_ten[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    MYJSON_STATS_TIME(number_ns);
+    size_t start = index;
+    bool negative = peek(str, index) == '-';
+    if (negative) {
+        index++;
+    }
+    uint64_t mantissa = 0;
+    bool overflow = false;  // mantissa has more digits than fit in 64 bits
+    int64_t exponent = 0;   // decimal exponent applied to mantissa
+    auto accumulate = [&](int digit) {
+        if (mantissa > (UINT64_MAX - digit) / 10) {
+            overflow = true;
+        } else {
+            mantissa = mantissa * 10 + digit;
+        }
+    };
+    // integer part, no leading zeros
+    if (peek(str, index) == '0') {
+        index++;
+    } else if (digit_value(peek(str, index)) > 0) {
+        while (digit_value(peek(str, index)) >= 0) {
+            accumulate(digit_value(str[index++]));
+        }
+    } else {
+        return error_at(str, index, parse_error::invalid_number);
+    }
+    bool is_integer = true;
+    if (peek(str, index) == '.') {
+        is_integer = false;
+        index++;
+        if (digit_value(peek(str, index)) < 0) {
+            return error_at(str, index, parse_error::invalid_number);
+        }
+        while (digit_value(peek(str, index)) >= 0) {
+            accumulate(digit_value(str[index++]));
+            exponent--;
+        }
+    }
+    if (peek(str, index) == 'e' || peek(str, index) == 'E') {
+        is_integer = false;
+        index++;
+        bool negative_exponent = peek(str, index) == '-';
+        if (negative_exponent || peek(str, index) == '+') {
+            index++;
+        }
+        if (digit_value(peek(str, index)) < 0) {
+            return error_at(str, index, parse_error::invalid_number);
+        }
+        int64_t value = 0;
+        while (digit_value(peek(str, index)) >= 0) {
+            // larger exponents overflow or underflow anyway
+            if (value < 100000) {
+                value = value * 10 + digit_value(str[index]);
+            }
+            index++;
+        }
+        exponent += negative_exponent ? -value : value;
+    }
+    if (is_integer && !overflow) {
+        if (!negative && mantissa <= uint64_t(INT64_MAX)) {
+            out = json(static_cast<int64_t>(mantissa));
+            MYJSON_STATS_ADD(ints, 1);
+            return parse_error::none;
+        } else if (negative && mantissa <= uint64_t(INT64_MAX) + 1) {
+            out = json(static_cast<int64_t>(0 - mantissa));
+            MYJSON_STATS_ADD(ints, 1);
+            return parse_error::none;
+        }
+        // out of int64 range, stored as a double below
+    }
+    // exact when both the mantissa and the power of ten fit in a double
+    if (!overflow && mantissa <= (uint64_t(1) << 53) && exponent >= -22 &&
+        exponent <= 22) {
+        double value = static_cast<double>(mantissa);
+        if (exponent < 0) {
+            value /= powers_of_ten[-exponent];
+        } else {
+            value *= powers_of_ten[exponent];
+        }
+        out = json(negative ? -value : value);
+        MYJSON_STATS_ADD(floats, 1);
+        return parse_error::none;
+    }
+    double value = 0;
+#if defined(__cpp_lib_to_chars)
+    // locale independent and allocation free (Eisel-Lemire in libstdc++)
+    auto result =
+        std::from_chars(str.data() + start, str.data() + index, value);
+    if (result.ec != std::errc() || result.ptr != str.data() + index) {
+        index = start;
+        return parse_error::invalid_number;
+    }
+#else
+    std::string token(str.substr(start, index - start));
+    char* end = nullptr;
+    value = std::strtod(token.c_str(), &end);
+    if (end != token.c_str() + token.size() || !std::isfinite(value)) {
+        index = start;
+        return parse_error::invalid_number;
+    }
+#endif
+    out = json(value);
+    MYJSON_STATS_ADD(floats, 1);
+    return parse_error::none;
+}
+
+// SAX interface
+// events reported by parse_sax(), return false from any of them to stop
+// parsing with parse_error::cancelled. Strings and keys are only valid
+// during the call, they point into the input or into a scratch buffer.
+class sax_handler {
+   public:
+    virtual ~sax_handler() = default;
+
+    virtual bool on_null() { return true; }
+    virtual bool on_bool(_bool) { return true; }
+    virtual bool on_int(_int) { return true; }
+    virtual bool on_double(_float) { return true; }
+    virtual bool on_string(std::string_view) { return true; }
+    virtual bool on_key(std::string_view) { return true; }
+    virtual bool start_object() { return true; }
+    virtual bool end_object() { return true; }
+    virtual bool start_array() { return true; }
+    virtual bool end_array() { return true; }
+};
+
+namespace detail {
+
+// scanning tokenizer, reports each token to Handler, which is a
+// sax_handler or any class with the same member functions. Open arrays
+// and objects are kept on an explicit stack, so deep nesting costs a byte
+// per level instead of a call frame.
+template <class Handler>
+class sax_reader {
+   public:
+    sax_reader(std::string_view str, size_t index, Handler& handler,
+               size_t max_depth = default_max_depth)
+        : str(str), index(index), handler(handler), max_depth(max_depth) {}
+
+    parse_error parse() {
+        while (true) {
+            bool opened = false;
+            parse_error error = parse_value(opened);
+            if (error != parse_error::none) {
+                return error;
+            }
+            // the first value of a new array or object comes next
+            if (opened) {
+                continue;
+            }
+            bool done = false;
+            error = parse_next(done);
+            if (error != parse_error::none || done) {
+                return error;
+            }
+        }
+    }
+
+    // after the value, or at the error
+    size_t position() const { return index; }
+
+    // read the next input, keeping the scratch buffer and the stack
+    void reset(std::string_view next_str, size_t next_index) {
+        str = next_str;
+        index = next_index;
+        open.clear();
+    }
+
+   private:
+    std::string_view str;
+    size_t index;
+    Handler& handler;
+    size_t max_depth;
+    std::string scratch;  // decoded strings and keys with escapes
+    std::vector<char> open;  // '[' or '{' for each open container
+
+    static parse_error check(bool proceed) {
+        return proceed ? parse_error::none : parse_error::cancelled;
+    }
+
+    // a scalar, or the start of an array or object. opened is set when a
+    // non-empty container was opened and its first value is next.
+    parse_error parse_value(bool& opened) {
+        skip_whitespace(str, index);
+        char c = peek(str, index);
+        if (c == '\"') {
+            return parse_string(false);
+        } else if (c == '[' || c == '{') {
+            return parse_container(c, opened);
+        }
+        json scalar;
+        parse_error error;
+        if (c == 'n') {
+            error = parse_null(str, index, scalar);
+        } else if (c == 't') {
+            error = parse_true(str, index, scalar);
+        } else if (c == 'f') {
+            error = parse_false(str, index, scalar);
+        } else if (std::isdigit(static_cast<unsigned char>(c)) || c == '-') {
+            error = parse_number(str, index, scalar);
+        } else {
+            return error_at(str, index, parse_error::invalid_value);
+        }
+        if (error != parse_error::none) {
+            return error;
+        }
+        switch (scalar.get_type()) {
+            case json::Type::_null: return check(handler.on_null());
+            case json::Type::_bool:
+                return check(handler.on_bool(scalar.as_bool()));
+            case json::Type::_int:
+                return check(handler.on_int(scalar.as_int()));
+            default: return check(handler.on_double(scalar.as_float()));
+        }
+    }
+
+    parse_error parse_string(bool is_key) {
+        size_t start = index + 1;
+        size_t end = start;
+        bool has_escape = false;
+        // an escaped quote does not terminate the string
+        while (end < str.size() && str[end] != '\"') {
+            if (str[end] == '\\') {
+                has_escape = true;
+                end++;
+            }
+            end++;
+        }
+        if (end >= str.size()) {
+            index = str.size();
+            return parse_error::unexpected_end;
+        }
+        std::string_view body = str.substr(start, end - start);
+        if (has_escape) {
+            size_t bad_escape = try_unescape_string(body, scratch);
+            if (bad_escape != std::string_view::npos) {
+                index = start + bad_escape;
+                return parse_error::invalid_escape;
+            }
+            body = scratch;
+        }
+        index = end + 1;
+        if (is_key) {
+            MYJSON_STATS_ADD(keys, 1);
+        } else {
+            MYJSON_STATS_ADD(strings, 1);
+        }
+        return check(is_key ? handler.on_key(body) : handler.on_string(body));
+    }
+
+    parse_error parse_container(char bracket, bool& opened) {
+        if (open.size() >= max_depth) {
+            return error_at(str, index, parse_error::too_deep);
+        }
+        bool is_array = bracket == '[';
+        if (is_array) {
+            MYJSON_STATS_ADD(arrays, 1);
+        } else {
+            MYJSON_STATS_ADD(objects, 1);
+        }
+        MYJSON_STATS_DEPTH(open.size() + 1);
+        index++;
+        parse_error error =
+            check(is_array ? handler.start_array() : handler.start_object());
+        if (error != parse_error::none) {
+            return error;
+        }
+        skip_whitespace(str, index);
+        if (peek(str, index) == (is_array ? ']' : '}')) {
+            index++;
+            return check(is_array ? handler.end_array()
+                                  : handler.end_object());
+        }
+        open.push_back(bracket);
+        opened = true;
+        return is_array ? parse_error::none : parse_key();
+    }
+
+    // a member key and its colon
+    parse_error parse_key() {
+        skip_whitespace(str, index);
+        if (peek(str, index) != '\"') {
+            return error_at(str, index, parse_error::expected_key);
+        }
+        parse_error error = parse_string(true);
+        if (error != parse_error::none) {
+            return error;
+        }
+        skip_whitespace(str, index);
+        if (peek(str, index) != ':') {
+            return error_at(str, index, parse_error::expected_colon);
+        }
+        index++;
+        return parse_error::none;
+    }
+
+    // after a value: consume the ',' before the next one, or close the
+    // containers that end here. done is set when the root value is complete.
+    parse_error parse_next(bool& done) {
+        while (!open.empty()) {
+            bool is_array = open.back() == '[';
+            skip_whitespace(str, index);
+            char c = peek(str, index);
+            if (c == ',') {
+                index++;
+                return is_array ? parse_error::none : parse_key();
+            } else if (c == (is_array ? ']' : '}')) {
+                index++;
+                open.pop_back();
+                parse_error error = check(is_array ? handler.end_array()
+                                                   : handler.end_object());
+                if (error != parse_error::none) {
+                    return error;
+                }
+            } else {
+                return error_at(str, index,
+                                is_array
+                                    ? parse_error::expected_comma_or_bracket
+                                    : parse_error::expected_comma_or_brace);
+            }
+        }
+        done = true;
+        return parse_error::none;
+    }
+};
+
+// sax handler that builds the json tree in place: each value is written
+// straight into its array element or object member, so nothing is moved
+// once it is parsed
+class dom_builder {
+   public:
+    dom_builder(std::string_view input, const parse_options& options,
+                json& root)
+        : input(input), options(options), root(&root) {
+        containers.reserve(32);
+    }
+
+    // build the next document into root, keeping the container stack
+    void reset(std::string_view next_input, json& next_root) {
+        input = next_input;
+        root = &next_root;
+        containers.clear();
+        member = nullptr;
+    }
+
+    bool on_null() {
+        slot() = json();
+        return true;
+    }
+    bool on_bool(_bool value) {
+        slot() = json(value);
+        return true;
+    }
+    bool on_int(_int value) {
+        slot() = json(value);
+        return true;
+    }
+    bool on_double(_float value) {
+        slot() = json(value);
+        return true;
+    }
+    bool on_string(std::string_view str) {
+        json& target = slot();
+        // decoded strings live in the reader's scratch buffer
+        if (options.zero_copy_strings && in_input(str)) {
+            target = json::make_view(str);
+        } else {
+            target = json(_string(str, options.memory()));
+        }
+        return true;
+    }
+    // a repeated key replaces the earlier value
+    bool on_key(std::string_view key) {
+        member = &member_slot(containers.back()->as_object(), key,
+                              options.keys);
+        return true;
+    }
+    bool start_object() {
+        json& target = slot();
+        target = json(_object(options.memory()));
+        containers.push_back(&target);
+        return true;
+    }
+    bool end_object() {
+        containers.pop_back();
+        return true;
+    }
+    bool start_array() {
+        json& target = slot();
+        target = json(_array(options.memory()));
+        containers.push_back(&target);
+        return true;
+    }
+    bool end_array() {
+        containers.pop_back();
+        return true;
+    }
+
+   private:
+    std::string_view input;
+    const parse_options& options;
+    json* root;
+    // open arrays and objects, a parent is not modified while a child is
+    // open, so the pointers stay valid
+    std::vector<json*> containers;
+    json* member = nullptr;  // set by on_key
+
+    // where the next value goes
+    json& slot() {
+        if (containers.empty()) {
+            return *root;
+        }
+        json* top = containers.back();
+        if (top->get_type() == json::Type::_array) {
+            return top->as_array().emplace_back();
+        }
+        return *member;
+    }
+
+    bool in_input(std::string_view str) const {
+        std::less_equal<const char*> before;
+        return before(input.data(), str.data()) &&
+               before(str.data() + str.size(), input.data() + input.size());
+    }
+};
+
+}  // namespace detail
+
+// parse str and report it to handler as events instead of building a tree,
+// handler is a sax_handler or any class with the same member functions
+template <class Handler>
+parse_result parse_sax(std::string_view str, Handler& handler,
+                       size_t max_depth = default_max_depth) {
+    MYJSON_STATS_SCOPE(stats_operation::parse);
+    detail::sax_reader<Handler> reader(str, 0, handler, max_depth);
+    parse_error error = reader.parse();
+    MYJSON_STATS_ADD(bytes_scanned, error != parse_error::none
+                                        ? reader.position()
+                                        : str.size());
+    if (error != parse_error::none) {
+        return make_parse_result(str, error, reader.position());
+    }
+    return parse_result();
+}
+
+// parse the value at index and advance index past it, throws on errors
+json parse(std::string_view str, size_t& index,
+           const parse_options& options = parse_options()) {
+    json result;
+    detail::dom_builder builder(str, options, result);
+    detail::sax_reader<detail::dom_builder> reader(str, index, builder,
+                                                   options.max_depth);
+    parse_error error = reader.parse();
+    index = reader.position();
+    if (error != parse_error::none) {
+        MYJSON_THROW(std::runtime_error(
+            parse_error_string(make_parse_result(str, error, index))));
+    }
+    return result;
+}
+
+// Structural index (stage 1)
+// Offsets of every token start: structural characters outside strings,
+// both quotes of each string and the first byte of each literal or number.
+// The last entry is always str.size() as an end marker.
+struct structural_index {
+    std::vector<uint32_t> positions;
+};
+
+namespace detail {
+
+// one bit per byte of a 64-byte block
+struct block_masks {
+    uint64_t quote = 0;
+    uint64_t backslash = 0;
+    uint64_t structural = 0;  // { } [ ] : ,
+    uint64_t whitespace = 0;
+};
+
+void classify_block_scalar(const char* block, block_masks& masks) {
+    masks = block_masks();
+    for (int i = 0; i < 64; ++i) {
+        uint64_t bit = uint64_t(1) << i;
+        switch (block[i]) {
+            case '\"': masks.quote |= bit; break;
+            case '\\': masks.backslash |= bit; break;
+            case '{': case '}': case '[': case ']': case ':': case ',':
+                masks.structural |= bit;
+                break;
+            case ' ': case '\t': case '\n': case '\r':
+                masks.whitespace |= bit;
+                break;
+            default: break;
+        }
+    }
+}
+
+#if defined(MYJSON_SIMD_X86)
+void classify_block_sse2(const char* block, block_masks& masks) {
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i lower = _mm_set1_epi8(0x20);
+    // '[' | 0x20 == '{' and ']' | 0x20 == '}'
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    masks = block_masks();
+    for (int i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(block + 16 * i));
+        __m128i folded = _mm_or_si128(v, lower);
+        __m128i structural = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, open),
+                         _mm_cmpeq_epi8(folded, close)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, comma)));
+        __m128i whitespace = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, lf), _mm_cmpeq_epi8(v, cr)));
+        int shift = 16 * i;
+        masks.quote |= uint64_t(uint32_t(_mm_movemask_epi8(
+                           _mm_cmpeq_epi8(v, quote))))
+                       << shift;
+        masks.backslash |= uint64_t(uint32_t(_mm_movemask_epi8(
+                               _mm_cmpeq_epi8(v, backslash))))
+                           << shift;
+        masks.structural |= uint64_t(uint32_t(_mm_movemask_epi8(structural)))
+                            << shift;
+        masks.whitespace |= uint64_t(uint32_t(_mm_movemask_epi8(whitespace)))
+                            << shift;
+    }
+}
+
+__attribute__((target("avx2"))) void classify_block_avx2(
+    const char* block, block_masks& masks) {
+    const __m256i quote = _mm256_set1_epi8('\"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i lower = _mm256_set1_epi8(0x20);
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    masks = block_masks();
+    for (int i = 0; i < 2; ++i) {
+        __m256i v = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(block + 32 * i));
+        __m256i folded = _mm256_or_si256(v, lower);
+        __m256i structural = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(folded, open),
+                            _mm256_cmpeq_epi8(folded, close)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, colon),
+                            _mm256_cmpeq_epi8(v, comma)));
+        __m256i whitespace = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, space),
+                            _mm256_cmpeq_epi8(v, tab)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, lf),
+                            _mm256_cmpeq_epi8(v, cr)));
+        int shift = 32 * i;
+        masks.quote |= uint64_t(uint32_t(_mm256_movemask_epi8(
+                           _mm256_cmpeq_epi8(v, quote))))
+                       << shift;
+        masks.backslash |= uint64_t(uint32_t(_mm256_movemask_epi8(
+                               _mm256_cmpeq_epi8(v, backslash))))
+                           << shift;
+        masks.structural |=
+            uint64_t(uint32_t(_mm256_movemask_epi8(structural))) << shift;
+        masks.whitespace |=
+            uint64_t(uint32_t(_mm256_movemask_epi8(whitespace))) << shift;
+    }
+}
+#endif
+
+#if defined(MYJSON_SIMD_NEON)
+// 16-bit mask of the bytes set in a comparison result
+uint64_t neon_movemask(uint8x16_t cmp) {
+    static const uint8_t bits[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                     1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t masked = vandq_u8(cmp, vld1q_u8(bits));
+    return uint64_t(vaddv_u8(vget_low_u8(masked))) |
+           (uint64_t(vaddv_u8(vget_high_u8(masked))) << 8);
+}
+
+void classify_block_neon(const char* block, block_masks& masks) {
+    masks = block_masks();
+    for (int i = 0; i < 4; ++i) {
+        uint8x16_t v =
+            vld1q_u8(reinterpret_cast<const uint8_t*>(block + 16 * i));
+        uint8x16_t folded = vorrq_u8(v, vdupq_n_u8(0x20));
+        uint8x16_t structural =
+            vorrq_u8(vorrq_u8(vceqq_u8(folded, vdupq_n_u8('{')),
+                              vceqq_u8(folded, vdupq_n_u8('}'))),
+                     vorrq_u8(vceqq_u8(v, vdupq_n_u8(':')),
+                              vceqq_u8(v, vdupq_n_u8(','))));
+        uint8x16_t whitespace =
+            vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')),
+                              vceqq_u8(v, vdupq_n_u8('\t'))),
+                     vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')),
+                              vceqq_u8(v, vdupq_n_u8('\r'))));
+        int shift = 16 * i;
+        masks.quote |= neon_movemask(vceqq_u8(v, vdupq_n_u8('\"'))) << shift;
+        masks.backslash |= neon_movemask(vceqq_u8(v, vdupq_n_u8('\\')))
+                           << shift;
+        masks.structural |= neon_movemask(structural) << shift;
+        masks.whitespace |= neon_movemask(whitespace) << shift;
+    }
+}
+#endif
+
+using classify_block_fn = void (*)(const char*, block_masks&);
+
+// pick the widest classifier the running cpu supports, once
+classify_block_fn select_classifier(const char** name = nullptr) {
+    static const char* selected_name = nullptr;
+    static const classify_block_fn selected = [] {
+#if defined(MYJSON_SIMD_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            selected_name = "avx2";
+            return &classify_block_avx2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            selected_name = "sse2";
+            return &classify_block_sse2;
+        }
+#elif defined(MYJSON_SIMD_NEON)
+        selected_name = "neon";
+        return &classify_block_neon;
+#endif
+        selected_name = "scalar";
+        return &classify_block_scalar;
+    }();
+    if (name != nullptr) {
+        *name = selected_name;
+    }
+    return selected;
+}
+
+// bits of the bytes escaped by a backslash, carry holds whether the first
+// byte of the next block is escaped
+uint64_t find_escaped(uint64_t backslash, uint64_t& carry) {
+    const uint64_t odd_bits = 0xAAAAAAAAAAAAAAAAULL;
+    if (backslash == 0) {
+        uint64_t escaped = carry;
+        carry = 0;
+        return escaped;
+    }
+    uint64_t potential_escape = backslash & ~carry;
+    // runs of backslashes starting on even bits carry into odd bits and
+    // the other way round, which leaves a 1 after every escaping backslash
+    uint64_t codes =
+        (((potential_escape << 1) | odd_bits) - potential_escape) ^ odd_bits;
+    uint64_t escaped = codes ^ (backslash | carry);
+    carry = (codes & backslash) >> 63;
+    return escaped;
+}
+
+// bit i is the xor of bits 0..i
+uint64_t prefix_xor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+int count_trailing_zeros(uint64_t bits) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    int count = 0;
+    while ((bits & 1) == 0) {
+        bits >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+}  // namespace detail
+
+// name of the structural scanner picked for this cpu
+const char* structural_scanner_name() {
+    const char* name = nullptr;
+    detail::select_classifier(&name);
+    return name;
+}
+
+// classify the input 64 bytes at a time and collect the token offsets
+parse_error build_structural_index(std::string_view str,
+                                   structural_index& result) {
+    result.positions.clear();
+    if (str.size() >= UINT32_MAX) {
+        return parse_error::input_too_large;
+    }
+    result.positions.reserve(str.size() / 4 + 1);
+    detail::classify_block_fn classify = detail::select_classifier();
+    uint64_t escape_carry = 0;  // next block starts with an escaped byte
+    uint64_t in_string = 0;     // all ones if the previous block ended in one
+    uint64_t scalar_carry = 0;  // previous block ended inside a literal
+    detail::block_masks masks;
+    char tail[64];
+    for (size_t base = 0; base < str.size(); base += 64) {
+        const char* block = str.data() + base;
+        if (str.size() - base < 64) {
+            // pad the last block with whitespace
+            std::memset(tail, ' ', sizeof(tail));
+            std::memcpy(tail, block, str.size() - base);
+            block = tail;
+        }
+        classify(block, masks);
+        uint64_t escaped = detail::find_escaped(masks.backslash, escape_carry);
+        uint64_t quotes = masks.quote & ~escaped;
+        // from an opening quote up to (not including) its closing quote
+        uint64_t string_mask = detail::prefix_xor(quotes) ^ in_string;
+        in_string = uint64_t(int64_t(string_mask) >> 63);
+        uint64_t scalar = ~(masks.structural | masks.whitespace | masks.quote) &
+                          ~string_mask;
+        uint64_t scalar_start = scalar & ~((scalar << 1) | scalar_carry);
+        scalar_carry = scalar >> 63;
+        uint64_t tokens =
+            (masks.structural & ~string_mask) | quotes | scalar_start;
+        while (tokens != 0) {
+            result.positions.push_back(static_cast<uint32_t>(
+                base + detail::count_trailing_zeros(tokens)));
+            tokens &= tokens - 1;
+        }
+    }
+    result.positions.push_back(static_cast<uint32_t>(str.size()));
+    if (in_string != 0) {
+        // unterminated string
+        return parse_error::unexpected_end;
+    }
+    return parse_error::none;
+}
+
+structural_index build_structural_index(std::string_view str) {
+    structural_index result;
+    parse_error error = build_structural_index(str, result);
+    if (error != parse_error::none) {
+        MYJSON_THROW(std::runtime_error(
+            std::string("At build_structural_index(): ") +
+            parse_error_message(error)));
+    }
+    return result;
+}
+
+// parse json by walking a structural index instead of scanning every byte.
+// Values are built in place and open containers are kept on an explicit
+// stack, like dom_builder, so nesting does not use the call stack.
+class structural_parser {
+   public:
+    structural_parser(std::string_view str, const structural_index& index,
+                      const parse_options& options)
+        : str(str), positions(index.positions.data()), options(options) {}
+    // start at any value token of an index
+    structural_parser(std::string_view str, const uint32_t* positions,
+                      const parse_options& options)
+        : str(str), positions(positions), options(options) {}
+
+    parse_error parse(json& out) {
+        count_elements();
+        root_end = 0;
+        json* target = &out;
+        while (true) {
+            bool opened = false;
+            parse_error error = parse_value(*target, opened);
+            if (error != parse_error::none) {
+                return error;
+            }
+            if (!opened) {
+                bool done = false;
+                error = parse_next(done);
+                if (error != parse_error::none || done) {
+                    return error;
+                }
+            }
+            target = &slot();
+        }
+    }
+
+    // byte offset of the last error
+    size_t error_offset() const { return offset; }
+    // offset after the value: of the next token, str.size() at the end
+    size_t position() const { return root_end != 0 ? root_end : *positions; }
+    // the root value is a literal or number its token goes on after, like
+    // the 1 of "1x"
+    bool ended_inside_token() const { return root_end != 0; }
+
+    // parse the next input, keeping the scratch key and the stack
+    void reset(std::string_view next_str, const uint32_t* next_positions) {
+        str = next_str;
+        positions = next_positions;
+        offset = 0;
+        containers.clear();
+        member = nullptr;
+    }
+
+   private:
+    std::string_view str;
+    const uint32_t* positions;  // next token
+    const parse_options& options;
+    std::string key_scratch;
+    size_t offset = 0;
+    // open arrays and objects, a parent is not modified while a child is
+    // open, so the pointers stay valid
+    std::vector<json*> containers;
+    json* member = nullptr;  // set by parse_key_token
+    // element counts of the arrays and objects in the order they open, and
+    // the next one to use
+    std::vector<uint32_t> sizes;
+    size_t next_size = 0;
+    std::vector<size_t> counting;  // containers open while counting
+    // end of a root literal or number that its token goes on after
+    size_t root_end = 0;
+
+    char current() const { return peek(str, *positions); }
+
+    // one pass over the tokens of the root value, so each array is
+    // allocated at its final size. On malformed input the counts may be
+    // off, they are only capacity hints.
+    void count_elements() {
+        sizes.clear();
+        counting.clear();
+        next_size = 0;
+        for (const uint32_t* token = positions; *token < str.size();
+             ++token) {
+            char c = str[*token];
+            if (c == '[' || c == '{') {
+                char next = peek(str, token[1]);
+                counting.push_back(sizes.size());
+                sizes.push_back(next == ']' || next == '}' ? 0 : 1);
+                continue;
+            } else if (c == ',') {
+                if (!counting.empty()) {
+                    sizes[counting.back()]++;
+                }
+                continue;
+            } else if (c == ':') {
+                continue;
+            } else if (c == ']' || c == '}') {
+                if (!counting.empty()) {
+                    counting.pop_back();
+                }
+            } else if (c == '\"') {
+                // a string has a token at each quote
+                if (*++token >= str.size()) {
+                    break;
+                }
+            }
+            if (counting.empty()) {
+                break;  // the root value is complete
+            }
+        }
+    }
+
+    parse_error fail(parse_error error, size_t at) {
+        offset = at;
+        return error_at(str, at, error);
+    }
+
+    // a scalar, or the start of an array or object. opened is set when a
+    // non-empty container was opened and its first value is next.
+    parse_error parse_value(json& out, bool& opened) {
+        char c = current();
+        if (c == '\"') {
+            return parse_string_token(out);
+        } else if (c == '[' || c == '{') {
+            return parse_container_token(out, opened);
+        }
+        size_t index = *positions;
+        parse_error error;
+        if (c == 'n') {
+            error = parse_null(str, index, out);
+        } else if (c == 't') {
+            error = parse_true(str, index, out);
+        } else if (c == 'f') {
+            error = parse_false(str, index, out);
+        } else if (std::isdigit(static_cast<unsigned char>(c)) || c == '-') {
+            error = parse_number(str, index, out);
+        } else {
+            return fail(parse_error::invalid_value, index);
+        }
+        if (error != parse_error::none) {
+            return fail(error, index);
+        }
+        ++positions;
+        skip_whitespace(str, index);
+        if (index != *positions) {
+            // the token goes on after the value, as in "[01]" or "nulll".
+            // The scanning parser ends the value there and fails on the
+            // rest, or leaves it to the caller after the root value.
+            if (containers.empty()) {
+                root_end = index;
+                return parse_error::none;
+            }
+            return fail(in_array() ? parse_error::expected_comma_or_bracket
+                                   : parse_error::expected_comma_or_brace,
+                        index);
+        }
+        return parse_error::none;
+    }
+
+    // the index holds both quotes of a string
+    parse_error parse_string_token(json& out) {
+        size_t start = positions[0] + 1;
+        size_t end = positions[1];
+        positions += 2;
+        std::string_view body = str.substr(start, end - start);
+        MYJSON_STATS_ADD(strings, 1);
+        bool has_escape =
+            std::memchr(body.data(), '\\', body.size()) != nullptr;
+        size_t bad_escape = parse_string_body(body, has_escape, options, out);
+        if (bad_escape != std::string_view::npos) {
+            return fail(parse_error::invalid_escape, start + bad_escape);
+        }
+        return parse_error::none;
+    }
+
+    // the member is added to the top object, a repeated key replaces the
+    // earlier value. Keys are copied into the object right away, so they
+    // are only decoded into scratch when they have escapes.
+    parse_error parse_key_token() {
+        if (current() != '\"') {
+            return fail(parse_error::expected_key, *positions);
+        }
+        size_t start = positions[0] + 1;
+        size_t end = positions[1];
+        positions += 2;
+        std::string_view key = str.substr(start, end - start);
+        MYJSON_STATS_ADD(keys, 1);
+        if (std::memchr(key.data(), '\\', key.size()) != nullptr) {
+            size_t bad_escape = try_unescape_string(key, key_scratch);
+            if (bad_escape != std::string_view::npos) {
+                return fail(parse_error::invalid_escape, start + bad_escape);
+            }
+            key = key_scratch;
+        }
+        if (current() != ':') {
+            return fail(parse_error::expected_colon, *positions);
+        }
+        ++positions;
+        member = &member_slot(containers.back()->as_object(), key,
+                              options.keys);
+        return parse_error::none;
+    }
+
+    parse_error parse_container_token(json& out, bool& opened) {
+        if (containers.size() >= options.max_depth) {
+            return fail(parse_error::too_deep, *positions);
+        }
+        bool is_array = current() == '[';
+        uint32_t size = next_size < sizes.size() ? sizes[next_size] : 0;
+        next_size++;
+        if (is_array) {
+            MYJSON_STATS_ADD(arrays, 1);
+            out = json(_array(options.memory()));
+        } else {
+            MYJSON_STATS_ADD(objects, 1);
+            out = json(_object(options.memory()));
+        }
+        if (size > 1) {
+            out.reserve(size);
+        }
+        MYJSON_STATS_DEPTH(containers.size() + 1);
+        ++positions;
+        if (current() == (is_array ? ']' : '}')) {
+            ++positions;
+            return parse_error::none;
+        }
+        containers.push_back(&out);
+        opened = true;
+        return is_array ? parse_error::none : parse_key_token();
+    }
+
+    // after a value: consume the ',' before the next one, or close the
+    // containers that end here. done is set when the root value is complete.
+    bool in_array() const {
+        return containers.back()->get_type() == json::Type::_array;
+    }
+
+    parse_error parse_next(bool& done) {
+        while (!containers.empty()) {
+            bool is_array = in_array();
+            char c = current();
+            if (c == ',') {
+                ++positions;
+                return is_array ? parse_error::none : parse_key_token();
+            } else if (c == (is_array ? ']' : '}')) {
+                ++positions;
+                containers.pop_back();
+            } else {
+                return fail(is_array ? parse_error::expected_comma_or_bracket
+                                     : parse_error::expected_comma_or_brace,
+                            *positions);
+            }
+        }
+        done = true;
+        return parse_error::none;
+    }
+
+    // where the next value goes
+    json& slot() {
+        json* top = containers.back();
+        if (top->get_type() == json::Type::_array) {
+            return top->as_array().emplace_back();
+        }
+        return *member;
+    }
+};
+
+namespace detail {
+
+// the first value of str into out. With whole_input only whitespace may
+// follow it and empty input is an error, otherwise the rest is ignored
+// and empty input is null.
+parse_result parse_document(std::string_view str, json& out,
+                            const parse_options& options, bool whole_input) {
+    MYJSON_STATS_SCOPE(stats_operation::parse);
+    if (str.empty()) {
+        out = json();
+        return whole_input ? make_parse_result(
+                                 str, parse_error::unexpected_end, 0)
+                           : parse_result();
+    }
+    parse_error error;
+    size_t offset = 0;
+    structural_index index;
+    // without closing quote the scanning parser finds the first error,
+    // which can come before the unterminated string
+    if (options.use_structural_index && str.size() < UINT32_MAX &&
+        build_structural_index(str, index) == parse_error::none) {
+        structural_parser parser(str, index, options);
+        error = parser.parse(out);
+        offset = error != parse_error::none ? parser.error_offset()
+                                            : parser.position();
+    } else {
+        out = json();
+        detail::dom_builder builder(str, options, out);
+        detail::sax_reader<detail::dom_builder> reader(str, 0, builder,
+                                                       options.max_depth);
+        error = reader.parse();
+        offset = reader.position();
+    }
+    if (error == parse_error::none && whole_input) {
+        error = check_trailing(str, offset);
+    }
+    if (error != parse_error::none) {
+        MYJSON_STATS_ADD(bytes_scanned, offset);
+        return make_parse_result(str, error, offset);
+    }
+    MYJSON_STATS_ADD(bytes_scanned, str.size());
+    return parse_result();
+}
+
+}  // namespace detail
+
+// parse str into out without throwing, out is unspecified on failure.
+// Empty input and anything but whitespace after the value are errors. The
+// input is read in place and never copied.
+parse_result parse(std::string_view str, json& out,
+                   const parse_options& options = parse_options()) {
+    return detail::parse_document(str, out, options, true);
+}
+
+// the input is read in place and never copied, throws on errors. Like the
+// first versions of parse(), empty input is null and text after the value
+// is ignored.
+json parse(std::string_view str,
+           const parse_options& options = parse_options()) {
+    json result;
+    parse_result status = detail::parse_document(str, result, options, false);
+    if (!status) {
+        MYJSON_THROW(std::runtime_error(parse_error_string(status)));
+    }
+    return result;
+}
+
+json parse(const char* str, size_t size,
+           const parse_options& options = parse_options()) {
+    return parse(std::string_view(str, size), options);
+}
+
+json parse(const std::string& str,
+           const parse_options& options = parse_options()) {
+    return parse(std::string_view(str), options);
+}
+
+json parse(const char* str, const parse_options& options = parse_options()) {
+    return parse(std::string_view(str), options);
+}
+
+// Lazy document
+// on-demand access through a structural index: operator[] skips over the
+// siblings before the wanted value without parsing them, and a value is
+// only decoded by value() or get<T>(). Skipped parts are not validated,
+// errors surface when a malformed value is reached.
+class lazy_document;
+
+class lazy_json {
+   public:
+    lazy_json() = default;
+
+    // false for the result of a failed find()
+    bool valid() const { return document != nullptr; }
+    explicit operator bool() const { return valid(); }
+
+    json::Type get_type() const;
+
+    // member, first match for repeated keys, throws if it is missing
+    lazy_json operator[](std::string_view key) const;
+    lazy_json operator[](const std::string& key) const {
+        return operator[](std::string_view(key));
+    }
+    lazy_json operator[](const char* key) const {
+        return operator[](std::string_view(key));
+    }
+    // array element, found by skipping the ones before it
+    lazy_json operator[](size_t index) const;
+    lazy_json operator[](int index) const;
+
+    // member that is invalid if it is missing or this is no object
+    lazy_json find(std::string_view key) const;
+    // element that is invalid if it is missing or this is no array
+    lazy_json find(size_t index) const;
+    bool contains(std::string_view key) const { return find(key).valid(); }
+
+    // number of array elements or object members
+    size_t size() const;
+
+    // source text of the value
+    std::string_view raw() const;
+
+    // parse this value and everything below it, strings without escapes
+    // point into the input
+    json value() const;
+
+    template <class T>
+    T get() const {
+        T result{};
+        from_json(value(), result);
+        return result;
+    }
+
+   private:
+    friend class lazy_document;
+
+    const lazy_document* document = nullptr;
+    const uint32_t* token = nullptr;  // first token of the value
+
+    lazy_json(const lazy_document* document, const uint32_t* token)
+        : document(document), token(token) {}
+
+    char first() const;
+    // the token after the value
+    const uint32_t* skip(const uint32_t* value) const;
+};
+
+class lazy_document {
+   public:
+    // only the structural index is built, str must outlive the document
+    explicit lazy_document(std::string_view str) : str(str) {
+        error = build_structural_index(str, index);
+    }
+    lazy_document(const lazy_document&) = delete;
+    lazy_document& operator=(const lazy_document&) = delete;
+
+    // errors of the index, an unterminated string or too large input
+    parse_result status() const {
+        if (error != parse_error::none) {
+            return make_parse_result(str, error, str.size());
+        }
+        return parse_result();
+    }
+
+    lazy_json root() const {
+        if (error != parse_error::none || str.empty()) {
+            MYJSON_THROW(std::runtime_error(
+                "At lazy_document::root(): invalid document"));
+        }
+        return lazy_json(this, index.positions.data());
+    }
+
+   private:
+    friend class lazy_json;
+
+    std::string_view str;
+    structural_index index;
+    parse_error error;
+
+    char at(const uint32_t* token) const { return peek(str, *token); }
+    bool at_end(const uint32_t* token) const {
+        return token >= index.positions.data() + index.positions.size() - 1;
+    }
+};
+
+char lazy_json::first() const {
+    if (!valid()) {
+        MYJSON_THROW(std::runtime_error("At lazy_json: value not found"));
+    }
+    return document->at(token);
+}
+
+const uint32_t* lazy_json::skip(const uint32_t* value) const {
+    char c = document->at(value);
+    if (c == '\"') {
+        return value + 2;
+    } else if (c != '[' && c != '{') {
+        return value + 1;
+    }
+    size_t depth = 0;
+    while (!document->at_end(value)) {
+        c = document->at(value);
+        if (c == '\"') {
+            value += 2;
+            continue;
+        }
+        if (c == '[' || c == '{') {
+            depth++;
+        } else if (c == ']' || c == '}') {
+            if (--depth == 0) {
+                return value + 1;
+            }
+        }
+        value++;
+    }
+    MYJSON_THROW(std::runtime_error("At lazy_json: unterminated value"));
+}
+
+json::Type lazy_json::get_type() const {
+    char c = first();
+    if (c == '\"') {
+        return json::Type::_string;
+    } else if (c == '[') {
+        return json::Type::_array;
+    } else if (c == '{') {
+        return json::Type::_object;
+    } else if (c == 't' || c == 'f') {
+        return json::Type::_bool;
+    } else if (c == 'n') {
+        return json::Type::_null;
+    }
+    // large integers are stored as floats, so the number is decoded
+    return value().get_type();
+}
+
+lazy_json lazy_json::find(std::string_view key) const {
+    if (first() != '{') {
+        return lazy_json();
+    }
+    std::string_view str = document->str;
+    const uint32_t* member = token + 1;
+    std::string decoded;
+    while (document->at(member) == '\"') {
+        std::string_view name =
+            str.substr(member[0] + 1, member[1] - member[0] - 1);
+        if (name.find('\\') != std::string_view::npos) {
+            if (try_unescape_string(name, decoded) !=
+                std::string_view::npos) {
+                MYJSON_THROW(std::runtime_error(
+                    "At lazy_json::find(): invalid escape character"));
+            }
+            name = decoded;
+        }
+        member += 2;
+        if (document->at(member) != ':') {
+            MYJSON_THROW(std::runtime_error(
+                "At lazy_json::find(): expected ':'"));
+        }
+        member++;
+        if (name == key) {
+            return lazy_json(document, member);
+        }
+        member = skip(member);
+        if (document->at(member) != ',') {
+            break;
+        }
+        member++;
+    }
+    return lazy_json();
+}
+
+lazy_json lazy_json::operator[](std::string_view key) const {
+    if (first() != '{') {
+        MYJSON_THROW(
+            std::runtime_error("At operator[]: json is not an object"));
+    }
+    lazy_json result = find(key);
+    if (!result.valid()) {
+        MYJSON_THROW(std::out_of_range("At operator[]: key not found"));
+    }
+    return result;
+}
+
+lazy_json lazy_json::find(size_t index) const {
+    if (first() != '[') {
+        return lazy_json();
+    }
+    const uint32_t* element = token + 1;
+    if (document->at(element) == ']') {
+        return lazy_json();
+    }
+    for (size_t i = 0; i < index; i++) {
+        element = skip(element);
+        if (document->at(element) != ',') {
+            return lazy_json();
+        }
+        element++;
+    }
+    return lazy_json(document, element);
+}
+
+lazy_json lazy_json::operator[](size_t index) const {
+    if (first() != '[') {
+        MYJSON_THROW(std::runtime_error("At operator[]: json is not an array"));
+    }
+    lazy_json result = find(index);
+    if (!result.valid()) {
+        MYJSON_THROW(std::runtime_error("At operator[]: index out of range"));
+    }
+    return result;
+}
+
+lazy_json lazy_json::operator[](int index) const {
+    if (index < 0) {
+        MYJSON_THROW(std::runtime_error("At operator[]: index is negative"));
+    }
+    return operator[](static_cast<size_t>(index));
+}
+
+size_t lazy_json::size() const {
+    char c = first();
+    if (c != '[' && c != '{') {
+        MYJSON_THROW(std::runtime_error(
+            "At size(): json is not an array or object"));
+    }
+    const uint32_t* element = token + 1;
+    if (document->at(element) == ']' || document->at(element) == '}') {
+        return 0;
+    }
+    size_t count = 1;
+    while (true) {
+        if (c == '{') {
+            element += 3;  // key and ':'
+        }
+        element = skip(element);
+        if (document->at(element) != ',') {
+            return count;
+        }
+        element++;
+        count++;
+    }
+}
+
+std::string_view lazy_json::raw() const {
+    char c = first();
+    std::string_view str = document->str;
+    size_t start = *token;
+    const uint32_t* next = skip(token);
+    size_t end;
+    if (c == '\"' || c == '[' || c == '{') {
+        end = next[-1] + 1;  // closing quote or bracket
+    } else {
+        // the next token, less the whitespace in between
+        end = *next;
+        while (end > start && (str[end - 1] == ' ' || str[end - 1] == '\t' ||
+                               str[end - 1] == '\n' ||
+                               str[end - 1] == '\r')) {
+            end--;
+        }
+    }
+    return str.substr(start, end - start);
+}
+
+json lazy_json::value() const {
+    first();
+    parse_options options;
+    options.zero_copy_strings = true;
+    json result;
+    structural_parser parser(document->str, token, options);
+    parse_error error = parser.parse(result);
+    size_t offset = parser.error_offset();
+    if (error == parse_error::none && parser.ended_inside_token()) {
+        // the value is not followed by a delimiter
+        error = result.get_type() == json::Type::_int ||
+                        result.get_type() == json::Type::_float
+                    ? parse_error::invalid_number
+                    : parse_error::invalid_literal;
+        offset = parser.position();
+    }
+    if (error != parse_error::none) {
+        MYJSON_THROW(std::runtime_error(parse_error_string(
+            make_parse_result(document->str, error, offset))));
+    }
+    return result;
+}
+
+// Paths
+// a sequence of member names and array indices, parsed once and then
+// looked up in any number of documents without allocating. json_path
+// takes expressions like "a.b[2].c", json_pointer the RFC 6901 syntax.
+class json_path {
+   public:
+    // the root value itself
+    json_path() = default;
+    // keys separated by '.', array indices in brackets, throws if the
+    // expression is malformed
+    explicit json_path(std::string_view expression);
+
+    // the value at the path, nullptr or an invalid lazy_json if it is
+    // missing
+    json* find(json& root) const;
+    const json* find(const json& root) const;
+    lazy_json find(const lazy_json& root) const;
+    bool contains(const json& root) const { return find(root) != nullptr; }
+    // the array or object the last step is looked up in, nullptr if it is
+    // missing or the path has no steps
+    json* find_parent(json& root) const;
+
+    // number of steps
+    size_t size() const { return steps.size(); }
+    // the last step, as a member name and as an array index (npos if it is
+    // none), the path must not be empty
+    const std::string& last_key() const { return steps.back().key; }
+    size_t last_index() const { return steps.back().index; }
+
+   protected:
+    // a step matches an object member named key, or the array element at
+    // index if key is a valid index
+    struct step {
+        std::string key;
+        size_t index;
+    };
+
+    std::vector<step> steps;
+
+    void add_step(std::string key);
+    json* find(json& root, size_t count) const;
+};
+
+class json_pointer : public json_path {
+   public:
+    // "" is the root, every other pointer is "/"-separated tokens with ~1
+    // for '/' and ~0 for '~', throws if the pointer is malformed
+    explicit json_pointer(std::string_view pointer);
+};
+
+void json_path::add_step(std::string key) {
+    // digits without a leading zero, as RFC 6901 requires
+    size_t index = std::string::npos;
+    bool digits = !key.empty() && key.size() < 20 &&
+                  (key[0] != '0' || key.size() == 1) &&
+                  std::all_of(key.begin(), key.end(),
+                              [](char c) { return c >= '0' && c <= '9'; });
+    if (digits) {
+        index = std::stoull(key);
+    }
+    steps.push_back({std::move(key), index});
+}
+
+json_path::json_path(std::string_view expression) {
+    size_t i = 0;
+    while (i < expression.size()) {
+        if (expression[i] == '[') {
+            size_t close = expression.find(']', i);
+            if (close == std::string_view::npos || close == i + 1) {
+                MYJSON_THROW(std::runtime_error(
+                    "At json_path(): expected an index in []"));
+            }
+            std::string index(expression.substr(i + 1, close - i - 1));
+            add_step(index);
+            if (steps.back().index == std::string::npos) {
+                MYJSON_THROW(
+                    std::runtime_error("At json_path(): invalid index"));
+            }
+            i = close + 1;
+            if (i < expression.size() && expression[i] == '.') {
+                i++;
+                if (i == expression.size()) {
+                    MYJSON_THROW(
+                        std::runtime_error("At json_path(): empty key"));
+                }
+            } else if (i < expression.size() && expression[i] != '[') {
+                MYJSON_THROW(std::runtime_error(
+                    "At json_path(): expected '.' or '[' after ']'"));
+            }
+            continue;
+        }
+        size_t end = expression.find_first_of(".[", i);
+        if (end == std::string_view::npos) {
+            end = expression.size();
+        }
+        if (end == i) {
+            MYJSON_THROW(std::runtime_error("At json_path(): empty key"));
+        }
+        add_step(std::string(expression.substr(i, end - i)));
+        i = end;
+        if (i < expression.size() && expression[i] == '.') {
+            i++;
+            if (i == expression.size()) {
+                MYJSON_THROW(std::runtime_error("At json_path(): empty key"));
+            }
+        }
+    }
+}
+
+json* json_path::find(json& root) const { return find(root, steps.size()); }
+
+json* json_path::find_parent(json& root) const {
+    if (steps.empty()) {
+        return nullptr;
+    }
+    json* parent = find(root, steps.size() - 1);
+    if (parent == nullptr || (parent->get_type() != json::Type::_array &&
+                              parent->get_type() != json::Type::_object)) {
+        return nullptr;
+    }
+    return parent;
+}
+
+// the value at the first count steps. Goes through the non-const
+// accessors, so shared nodes on the path are copied before the result can
+// be written.
+json* json_path::find(json& root, size_t count) const {
+    json* current = &root;
+    for (size_t i = 0; i < count; i++) {
+        const step& next = steps[i];
+        json::Type type = current->get_type();
+        if (type == json::Type::_object) {
+            current = current->find(next.key);
+            if (current == nullptr) {
+                return nullptr;
+            }
+        } else if (type == json::Type::_array &&
+                   next.index < current->as_array().size()) {
+            current = &current->as_array()[next.index];
+        } else {
+            return nullptr;
+        }
+    }
+    return current;
+}
+
+const json* json_path::find(const json& root) const {
+    const json* current = &root;
+    for (const step& next : steps) {
+        json::Type type = current->get_type();
+        if (type == json::Type::_object) {
+            current = current->find(next.key);
+            if (current == nullptr) {
+                return nullptr;
+            }
+        } else if (type == json::Type::_array &&
+                   next.index < current->as_array().size()) {
+            current = &current->as_array()[next.index];
+        } else {
+            return nullptr;
+        }
+    }
+    return current;
+}
+
+lazy_json json_path::find(const lazy_json& root) const {
+    lazy_json current = root;
+    for (const step& next : steps) {
+        if (!current.valid()) {
+            break;
+        }
+        json::Type type = current.get_type();
+        if (type == json::Type::_object) {
+            current = current.find(next.key);
+        } else if (type == json::Type::_array &&
+                   next.index != std::string::npos) {
+            current = current.find(next.index);
+        } else {
+            return lazy_json();
+        }
+    }
+    return current;
+}
+
+json_pointer::json_pointer(std::string_view pointer) {
+    if (pointer.empty()) {
+        return;
+    }
+    if (pointer[0] != '/') {
+        MYJSON_THROW(
+            std::runtime_error("At json_pointer(): must start with '/'"));
+    }
+    size_t start = 1;
+    while (true) {
+        size_t end = std::min(pointer.find('/', start), pointer.size());
+        std::string key;
+        for (size_t i = start; i < end; i++) {
+            if (pointer[i] != '~') {
+                key += pointer[i];
+            } else if (i + 1 < end && pointer[i + 1] == '0') {
+                key += '~';
+                i++;
+            } else if (i + 1 < end && pointer[i + 1] == '1') {
+                key += '/';
+                i++;
+            } else {
+                MYJSON_THROW(std::runtime_error(
+                    "At json_pointer(): invalid escape, expected ~0 or ~1"));
+            }
+        }
+        add_step(std::move(key));
+        if (end == pointer.size()) {
+            break;
+        }
+        start = end + 1;
+    }
+}
+
+// Patch
+// JSON Patch (RFC 6902) and JSON Merge Patch (RFC 7396) applied to a tree
+// in place, and diff() to compute a JSON Patch. Only the values a patch
+// names are touched, the rest of the document is neither copied nor
+// visited. The overloads that take the patch as an rvalue move its values
+// into the document instead of copying them.
+
+namespace detail {
+
+// a pointer token with '~' escaped as ~0 and '/' as ~1
+void append_pointer_token(std::string& pointer, std::string_view token) {
+    pointer += '/';
+    for (char c : token) {
+        if (c == '~') {
+            pointer += "~0";
+        } else if (c == '/') {
+            pointer += "~1";
+        } else {
+            pointer += c;
+        }
+    }
+}
+
+bool is_number(const json& value) {
+    json::Type type = value.get_type();
+    return type == json::Type::_int || type == json::Type::_float;
+}
+
+// exact, so 1 equals 1.0 but 2^53 + 1 does not equal 2^53
+bool same_number(const json& lhs, const json& rhs) {
+    if (lhs.get_type() == rhs.get_type()) {
+        return lhs == rhs;
+    }
+    _int integer =
+        lhs.get_type() == json::Type::_int ? lhs.as_int() : rhs.as_int();
+    _float number =
+        lhs.get_type() == json::Type::_float ? lhs.as_float() : rhs.as_float();
+    // the range of _int, where the cast is defined
+    _float limit = -static_cast<_float>(INT64_MIN);
+    if (!(number >= -limit && number < limit)) {
+        return false;
+    }
+    _int truncated = static_cast<_int>(number);
+    return static_cast<_float>(truncated) == number && truncated == integer;
+}
+
+// equality of the "test" op: like ==, but numbers compare by value
+// whether written as integers or not
+bool patch_equal(const json& lhs, const json& rhs) {
+    if (is_number(lhs) && is_number(rhs)) {
+        return same_number(lhs, rhs);
+    }
+    json::Type type = lhs.get_type();
+    if (type != rhs.get_type()) {
+        return false;
+    } else if (type == json::Type::_array) {
+        const _array& left = lhs.as_array();
+        const _array& right = rhs.as_array();
+        if (left.size() != right.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < left.size(); i++) {
+            if (!patch_equal(left[i], right[i])) {
+                return false;
+            }
+        }
+        return true;
+    } else if (type == json::Type::_object) {
+        if (lhs.as_object().size() != rhs.as_object().size()) {
+            return false;
+        }
+        for (const auto& member : lhs.as_object()) {
+            const json* other = rhs.find(member.first);
+            if (other == nullptr || !patch_equal(member.second, *other)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    return lhs == rhs;
+}
+
+template <class Json>
+Json& patch_member(Json& operation, std::string_view name) {
+    auto member = operation.find(name);
+    if (member == nullptr) {
+        MYJSON_THROW(std::runtime_error(
+            "At apply_patch(): operation has no \"" + std::string(name) +
+            "\""));
+    }
+    return *member;
+}
+
+std::string_view patch_string(const json& operation, std::string_view name) {
+    const json& member = patch_member(operation, name);
+    if (member.get_type() != json::Type::_string) {
+        MYJSON_THROW(std::runtime_error("At apply_patch(): \"" +
+                                        std::string(name) +
+                                        "\" is not a string"));
+    }
+    return member.get_string_view();
+}
+
+// the value of an operation, moved out of a patch passed as an rvalue
+json take_patch_value(json& value) { return std::move(value); }
+json take_patch_value(const json& value) { return value; }
+
+// a member is added or replaced, an element is inserted
+void patch_add(json& root, const json_pointer& path, json&& value) {
+    if (path.size() == 0) {
+        root = std::move(value);
+        return;
+    }
+    json* parent = path.find_parent(root);
+    if (parent == nullptr) {
+        MYJSON_THROW(std::runtime_error("At apply_patch(): path not found"));
+    }
+    if (parent->get_type() == json::Type::_object) {
+        (*parent)[path.last_key()] = std::move(value);
+        return;
+    }
+    _array& elements = parent->as_array();
+    if (path.last_key() == "-") {
+        elements.push_back(std::move(value));
+    } else if (path.last_index() <= elements.size()) {
+        elements.insert(elements.begin() + path.last_index(),
+                        std::move(value));
+    } else {
+        MYJSON_THROW(
+            std::runtime_error("At apply_patch(): index out of range"));
+    }
+}
+
+// takes the value at path out of the tree
+json patch_remove(json& root, const json_pointer& path) {
+    json* parent = path.find_parent(root);
+    json removed;
+    if (parent != nullptr && parent->get_type() == json::Type::_object) {
+        json* member = parent->find(path.last_key());
+        if (member != nullptr) {
+            removed = std::move(*member);
+            parent->remove(path.last_key());
+            return removed;
+        }
+    } else if (parent != nullptr &&
+               path.last_index() < parent->as_array().size()) {
+        _array& elements = parent->as_array();
+        removed = std::move(elements[path.last_index()]);
+        elements.erase(elements.begin() + path.last_index());
+        return removed;
+    }
+    MYJSON_THROW(std::runtime_error("At apply_patch(): path not found"));
+}
+
+template <class Json>
+void apply_operation(json& root, Json& operation) {
+    if (operation.get_type() != json::Type::_object) {
+        MYJSON_THROW(
+            std::runtime_error("At apply_patch(): operation is not an object"));
+    }
+    std::string_view op = patch_string(operation, "op");
+    std::string_view path_text = patch_string(operation, "path");
+    json_pointer path(path_text);
+    if (op == "add") {
+        patch_add(root, path,
+                  take_patch_value(patch_member(operation, "value")));
+    } else if (op == "remove") {
+        patch_remove(root, path);
+    } else if (op == "replace") {
+        json* target = path.find(root);
+        if (target == nullptr) {
+            MYJSON_THROW(
+                std::runtime_error("At apply_patch(): path not found"));
+        }
+        *target = take_patch_value(patch_member(operation, "value"));
+    } else if (op == "move") {
+        std::string_view from_text = patch_string(operation, "from");
+        if (from_text == path_text) {
+            return;
+        }
+        // a value cannot be moved into one of its own members
+        if (path_text.size() > from_text.size() &&
+            path_text.substr(0, from_text.size()) == from_text &&
+            path_text[from_text.size()] == '/') {
+            MYJSON_THROW(std::runtime_error(
+                "At apply_patch(): cannot move a value into itself"));
+        }
+        json value = patch_remove(root, json_pointer(from_text));
+        patch_add(root, path, std::move(value));
+    } else if (op == "copy") {
+        json_pointer from(patch_string(operation, "from"));
+        const json* source = from.find(static_cast<const json&>(root));
+        if (source == nullptr) {
+            MYJSON_THROW(
+                std::runtime_error("At apply_patch(): from not found"));
+        }
+        patch_add(root, path, json(*source));
+    } else if (op == "test") {
+        const json* target = path.find(static_cast<const json&>(root));
+        if (target == nullptr ||
+            !patch_equal(*target, patch_member(operation, "value"))) {
+            MYJSON_THROW(std::runtime_error("At apply_patch(): test failed"));
+        }
+    } else {
+        MYJSON_THROW(std::runtime_error("At apply_patch(): unknown op \"" +
+                                        std::string(op) + "\""));
+    }
+}
+
+template <class Json>
+void apply_operations(json& target, Json& patch) {
+    if (patch.get_type() != json::Type::_array) {
+        MYJSON_THROW(
+            std::runtime_error("At apply_patch(): patch is not an array"));
+    }
+    for (auto& operation : patch.as_array()) {
+        apply_operation(target, operation);
+    }
+}
+
+template <class Json>
+void merge_into(json& target, Json& patch) {
+    if (patch.get_type() != json::Type::_object) {
+        target = take_patch_value(patch);
+        return;
+    }
+    if (target.get_type() != json::Type::_object) {
+        target = _object();
+    }
+    for (auto& member : patch.as_object()) {
+        std::string_view key = member.first;
+        if (member.second.get_type() == json::Type::_null) {
+            target.remove(key);
+        } else {
+            merge_into(target[key], member.second);
+        }
+    }
+}
+
+void add_operation(json& patch, const char* op, const std::string& path,
+                   const json* value) {
+    json operation = json(_object());
+    operation["op"] = json(op);
+    operation["path"] = json(path);
+    if (value != nullptr) {
+        operation["value"] = *value;
+    }
+    patch.push(std::move(operation));
+}
+
+// path is the pointer to source and target, restored before returning
+void diff_values(const json& source, const json& target, std::string& path,
+                 json& patch) {
+    json::Type type = source.get_type();
+    if (&source == &target) {
+        return;
+    } else if (is_number(source) && is_number(target)) {
+        if (!same_number(source, target)) {
+            add_operation(patch, "replace", path, &target);
+        }
+    } else if (type != target.get_type()) {
+        add_operation(patch, "replace", path, &target);
+    } else if (type == json::Type::_object) {
+        const _object& from = source.as_object();
+        const _object& to = target.as_object();
+        if (&from == &to) {
+            // shared storage
+            return;
+        }
+        size_t length = path.size();
+        for (const auto& member : from) {
+            append_pointer_token(path, member.first);
+            const json* other = target.find(member.first);
+            if (other == nullptr) {
+                add_operation(patch, "remove", path, nullptr);
+            } else {
+                diff_values(member.second, *other, path, patch);
+            }
+            path.resize(length);
+        }
+        for (const auto& member : to) {
+            if (!source.contains(member.first)) {
+                append_pointer_token(path, member.first);
+                add_operation(patch, "add", path, &member.second);
+                path.resize(length);
+            }
+        }
+    } else if (type == json::Type::_array) {
+        const _array& from = source.as_array();
+        const _array& to = target.as_array();
+        if (&from == &to) {
+            return;
+        }
+        size_t length = path.size();
+        size_t common = std::min(from.size(), to.size());
+        for (size_t i = 0; i < to.size(); i++) {
+            path += '/';
+            path += std::to_string(i);
+            if (i < common) {
+                diff_values(from[i], to[i], path, patch);
+            } else {
+                add_operation(patch, "add", path, &to[i]);
+            }
+            path.resize(length);
+        }
+        // from the end, so the indices of the others stay valid
+        for (size_t i = from.size(); i > common; i--) {
+            path += '/';
+            path += std::to_string(i - 1);
+            add_operation(patch, "remove", path, nullptr);
+            path.resize(length);
+        }
+    } else if (source != target) {
+        add_operation(patch, "replace", path, &target);
+    }
+}
+
+}  // namespace detail
+
+// apply the operations of patch, an array, in order. Throws on the first
+// operation that fails or is malformed, the ones before it stay applied.
+void apply_patch(json& target, const json& patch) {
+    detail::apply_operations(target, patch);
+}
+
+void apply_patch(json& target, json&& patch) {
+    detail::apply_operations(target, patch);
+}
+
+// members of patch replace those of target, null members remove them
+void merge_patch(json& target, const json& patch) {
+    detail::merge_into(target, patch);
+}
+
+void merge_patch(json& target, json&& patch) {
+    detail::merge_into(target, patch);
+}
+
+// the JSON Patch that turns source into target, walking both trees once.
+// Subtrees that share storage (json::share()) are equal and skipped.
+json diff(const json& source, const json& target) {
+    json patch = json(_array());
+    std::string path;
+    detail::diff_values(source, target, path, patch);
+    return patch;
+}
+
+// Stream parser
+// push parser for input that arrives in chunks: each feed() parses as far as
+// the chunk goes and keeps the partial tree, the open containers and any
+// unfinished token as explicit state, so no chunk has to be kept around.
+// Strings are always copied (zero_copy_strings and use_structural_index
+// are ignored), options.resource is used for the tree.
+//
+//     myjson::stream_parser parser;
+//     while (read(socket, buffer)) parser.feed(buffer, size);
+//     if (parser.finish()) use(parser.root());
+class stream_parser {
+   public:
+    explicit stream_parser(const parse_options& options = parse_options())
+        : options(options) {
+        this->options.zero_copy_strings = false;
+    }
+
+    // parse the next chunk, returns the error once one was found and
+    // ignores any further input
+    parse_result feed(const char* data, size_t size) {
+        chunk = data;
+        size_t i = 0;
+        while (i < size && error == parse_error::none) {
+            if (lexer == lexer_state::string) {
+                i = scan_string(data, size, i);
+            } else if (lexer == lexer_state::scalar) {
+                i = scan_scalar(data, size, i);
+            } else {
+                char c = data[i];
+                if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+                    handle_token(c, consumed + i);
+                }
+                if (lexer != lexer_state::scalar) {
+                    i++;
+                }
+            }
+        }
+        if (error == parse_error::none) {
+            count_lines(consumed + i);
+        }
+        consumed += i;
+        return status();
+    }
+
+    parse_result feed(std::string_view chunk) {
+        return feed(chunk.data(), chunk.size());
+    }
+
+    // end of input, completes a trailing number or literal and checks that
+    // the document is complete. Empty input is an error like in
+    // parse(str, out).
+    parse_result finish() {
+        if (error == parse_error::none && lexer == lexer_state::scalar) {
+            finish_scalar(true);
+        }
+        if (error == parse_error::none && state != parser_state::done) {
+            error = parse_error::unexpected_end;
+            error_offset = consumed;
+        }
+        return status();
+    }
+
+    // the parsed value, complete after a successful finish()
+    json& root() { return root_value; }
+    const json& root() const { return root_value; }
+
+    // errors are sticky, the position is the one of the first error
+    parse_result status() const {
+        parse_result result;
+        result.error = error;
+        if (error != parse_error::none) {
+            result.offset = error_offset;
+            result.line = line;
+            result.column = error_offset - line_start + 1;
+        }
+        return result;
+    }
+
+    // start over with a new document
+    void reset() {
+        stack.clear();
+        token.clear();
+        root_value = json();
+        state = parser_state::start;
+        lexer = lexer_state::none;
+        error = parse_error::none;
+        consumed = 0;
+        error_offset = 0;
+        counted = 0;
+        line = 1;
+        line_start = 0;
+    }
+
+   private:
+    enum class parser_state {
+        start,          // before the root value
+        value,          // after ':' or ',' in an array
+        array_first,    // after '[', a value or ']'
+        object_first,   // after '{', a key or '}'
+        object_key,     // after ',' in an object
+        colon,          // after a key
+        after_value,    // ',' or the closing bracket
+        done            // after the root value, only whitespace may follow
+    };
+    enum class lexer_state { none, string, scalar };
+    // the part of a number the last byte was in
+    enum class number_state {
+        start,           // nothing yet
+        sign,            // after the leading '-'
+        zero,            // a leading 0, no more integer digits may follow
+        integer,
+        point,           // after '.', a digit must follow
+        fraction,
+        exponent,        // after 'e' or 'E', a sign or digit must follow
+        exponent_sign,
+        exponent_digits
+    };
+
+    // an open array or object and, for objects, the key of the member
+    // being parsed
+    struct frame {
+        json container;
+        std::string key;
+    };
+
+    parse_options options;
+    std::vector<frame> stack;
+    json root_value;
+    parser_state state = parser_state::start;
+    lexer_state lexer = lexer_state::none;
+    parse_error error = parse_error::none;
+
+    // unfinished string body (raw) or number / literal
+    std::string token;
+    size_t token_start = 0;  // offset of the opening quote or first char
+    size_t token_body = 0;   // offset of token[0]
+    bool string_is_key = false;
+    bool string_has_escape = false;
+    bool escape_pending = false;  // the last byte was an unpaired backslash
+    number_state number = number_state::start;
+
+    const char* chunk = nullptr;  // input of the running feed()
+    size_t consumed = 0;  // bytes of all previous chunks
+    size_t error_offset = 0;
+    // line and offset of the line start at counted, and of the error once
+    // there is one
+    size_t counted = 0;
+    size_t line = 1;
+    size_t line_start = 0;
+    size_t token_line = 1;  // at token_start
+    size_t token_line_start = 0;
+
+    void fail(parse_error code, size_t offset) {
+        error = code;
+        error_offset = offset;
+        if (offset >= counted) {
+            count_lines(offset);
+            return;
+        }
+        // inside the current token, which may have begun in an earlier chunk
+        line = token_line;
+        line_start = token_line_start;
+        for (size_t i = token_body; i < offset; i++) {
+            if (token[i - token_body] == '\n') {
+                line++;
+                line_start = i + 1;
+            }
+        }
+    }
+
+    // count the lines of the current chunk up to offset
+    void count_lines(size_t offset) {
+        for (; counted < offset; counted++) {
+            if (chunk[counted - consumed] == '\n') {
+                line++;
+                line_start = counted + 1;
+            }
+        }
+    }
+
+    void begin_token(size_t offset, size_t body) {
+        count_lines(offset);
+        token.clear();
+        token_start = offset;
+        token_body = body;
+        token_line = line;
+        token_line_start = line_start;
+    }
+
+    bool in_array() const {
+        return stack.back().container.get_type() == json::Type::_array;
+    }
+
+    // structural character or the first byte of a string or scalar
+    void handle_token(char c, size_t offset) {
+        switch (state) {
+            case parser_state::start:
+            case parser_state::value:
+            case parser_state::array_first:
+                if (c == ']' && state == parser_state::array_first) {
+                    close_container();
+                } else {
+                    begin_value(c, offset);
+                }
+                break;
+            case parser_state::object_first:
+            case parser_state::object_key:
+                if (c == '}' && state == parser_state::object_first) {
+                    close_container();
+                } else if (c == '\"') {
+                    begin_string(true, offset);
+                } else {
+                    fail(parse_error::expected_key, offset);
+                }
+                break;
+            case parser_state::colon:
+                if (c == ':') {
+                    state = parser_state::value;
+                } else {
+                    fail(parse_error::expected_colon, offset);
+                }
+                break;
+            case parser_state::after_value:
+                if (c == ',') {
+                    state = in_array() ? parser_state::value
+                                       : parser_state::object_key;
+                } else if (c == (in_array() ? ']' : '}')) {
+                    close_container();
+                } else {
+                    fail(in_array() ? parse_error::expected_comma_or_bracket
+                                    : parse_error::expected_comma_or_brace,
+                         offset);
+                }
+                break;
+            case parser_state::done:
+                fail(parse_error::trailing_characters, offset);
+                break;
+        }
+    }
+
+    void begin_value(char c, size_t offset) {
+        if ((c == '[' || c == '{') && stack.size() >= options.max_depth) {
+            fail(parse_error::too_deep, offset);
+        } else if (c == '[') {
+            stack.push_back({json(_array(options.memory())), std::string()});
+            state = parser_state::array_first;
+        } else if (c == '{') {
+            stack.push_back({json(_object(options.memory())), std::string()});
+            state = parser_state::object_first;
+        } else if (c == '\"') {
+            begin_string(false, offset);
+        } else if (c == '-' || c == 't' || c == 'f' || c == 'n' ||
+                   std::isdigit(static_cast<unsigned char>(c))) {
+            // the scalar is collected from this byte on
+            lexer = lexer_state::scalar;
+            begin_token(offset, offset);
+            number = number_state::start;
+        } else {
+            fail(parse_error::invalid_value, offset);
+        }
+    }
+
+    void begin_string(bool is_key, size_t offset) {
+        lexer = lexer_state::string;
+        begin_token(offset, offset + 1);
+        string_is_key = is_key;
+        string_has_escape = false;
+        escape_pending = false;
+    }
+
+    // append string bytes up to the closing quote
+    size_t scan_string(const char* data, size_t size, size_t i) {
+        size_t start = i;
+        for (; i < size; i++) {
+            char c = data[i];
+            if (escape_pending) {
+                escape_pending = false;
+            } else if (c == '\\') {
+                escape_pending = true;
+                string_has_escape = true;
+            } else if (c == '\"') {
+                break;
+            }
+        }
+        token.append(data + start, i - start);
+        if (i < size) {
+            lexer = lexer_state::none;
+            finish_string();
+            i++;  // closing quote
+        }
+        return i;
+    }
+
+    void finish_string() {
+        size_t bad_escape;
+        if (string_is_key) {
+            bad_escape = try_unescape_string(token, stack.back().key);
+            state = parser_state::colon;
+        } else {
+            json value;
+            bad_escape =
+                parse_string_body(token, string_has_escape, options, value);
+            complete_value(std::move(value));
+        }
+        if (bad_escape != std::string_view::npos) {
+            fail(parse_error::invalid_escape, token_start + 1 + bad_escape);
+        }
+    }
+
+    // append number or literal bytes up to the first byte that cannot
+    // continue the token, the same place the scanning parser stops
+    size_t scan_scalar(const char* data, size_t size, size_t i) {
+        size_t start = i;
+        char first = token.empty() ? data[i] : token[0];
+        if (first == 't' || first == 'f' || first == 'n') {
+            size_t length = first == 'f' ? 5 : 4;
+            while (i < size && token.size() + (i - start) < length &&
+                   data[i] >= 'a' && data[i] <= 'z') {
+                i++;
+            }
+        } else {
+            while (i < size && continue_number(data[i])) {
+                i++;
+            }
+        }
+        token.append(data + start, i - start);
+        if (i < size) {
+            finish_scalar(false);
+        }
+        return i;
+    }
+
+    // advance number through the number grammar, false if c cannot be
+    // the next byte of the number
+    bool continue_number(char c) {
+        bool digit = digit_value(c) >= 0;
+        switch (number) {
+            case number_state::start:
+                if (c == '-') {
+                    number = number_state::sign;
+                    return true;
+                }
+                [[fallthrough]];
+            case number_state::sign:
+                if (c == '0') {
+                    number = number_state::zero;
+                } else if (digit) {
+                    number = number_state::integer;
+                }
+                return digit;
+            case number_state::integer:
+            case number_state::zero:
+            case number_state::fraction:
+                if (digit && number != number_state::zero) {
+                    return true;
+                } else if (c == '.' && number != number_state::fraction) {
+                    number = number_state::point;
+                    return true;
+                } else if (c == 'e' || c == 'E') {
+                    number = number_state::exponent;
+                    return true;
+                }
+                return false;
+            case number_state::point:
+                if (digit) {
+                    number = number_state::fraction;
+                }
+                return digit;
+            case number_state::exponent:
+                if (c == '+' || c == '-') {
+                    number = number_state::exponent_sign;
+                    return true;
+                }
+                [[fallthrough]];
+            case number_state::exponent_sign:
+                if (digit) {
+                    number = number_state::exponent_digits;
+                }
+                return digit;
+            case number_state::exponent_digits: return digit;
+        }
+        return false;
+    }
+
+    void finish_scalar(bool at_end) {
+        lexer = lexer_state::none;
+        size_t index = 0;
+        json value;
+        parse_error code;
+        char c = token[0];
+        if (c == 'n') {
+            code = parse_null(token, index, value);
+        } else if (c == 't') {
+            code = parse_true(token, index, value);
+        } else if (c == 'f') {
+            code = parse_false(token, index, value);
+        } else {
+            code = parse_number(token, index, value);
+        }
+        bool is_number = c != 'n' && c != 't' && c != 'f';
+        if (code == parse_error::unexpected_end && !at_end) {
+            // the token was cut short by a delimiter, not by the input
+            if (is_number) {
+                code = parse_error::invalid_number;
+            } else {
+                code = parse_error::invalid_literal;
+                index = 0;
+            }
+        } else if (code == parse_error::none && index != token.size()) {
+            code = is_number ? parse_error::invalid_number
+                             : parse_error::invalid_literal;
+        }
+        if (code != parse_error::none) {
+            fail(code, token_start + index);
+            return;
+        }
+        complete_value(std::move(value));
+    }
+
+    void close_container() {
+        json value = std::move(stack.back().container);
+        stack.pop_back();
+        complete_value(std::move(value));
+    }
+
+    void complete_value(json&& value) {
+        if (stack.empty()) {
+            root_value = std::move(value);
+            state = parser_state::done;
+        } else if (in_array()) {
+            stack.back().container.as_array().push_back(std::move(value));
+            state = parser_state::after_value;
+        } else {
+            frame& top = stack.back();
+            member_slot(top.container.as_object(), top.key, options.keys) =
+                std::move(value);
+            state = parser_state::after_value;
+        }
+    }
+};
+
+// Files
+// read the whole file at path into out
+bool read_file(const std::string& path, std::string& out) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    out.clear();
+    char buffer[65536];
+    size_t size;
+    while ((size = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        out.append(buffer, size);
+    }
+    bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    return ok;
+}
+
+// read-only view of a whole file: mmap on unix, MapViewOfFile on windows,
+// read into memory elsewhere. data() stays valid until close().
+class mapped_file {
+   public:
+    mapped_file() = default;
+    explicit mapped_file(const std::string& path) { open(path); }
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    ~mapped_file() { close(); }
+
+    // false if the file cannot be opened or mapped
+    bool open(const std::string& path);
+    void close();
+
+    bool is_open() const { return opened; }
+    std::string_view data() const { return std::string_view(view, size); }
+
+   private:
+    const char* view = nullptr;
+    size_t size = 0;
+    bool opened = false;
+#if defined(_WIN32)
+    HANDLE mapping = nullptr;
+#elif !defined(MYJSON_MMAP)
+    std::string buffer;
+#endif
+};
+
+bool mapped_file::open(const std::string& path) {
+    close();
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        CloseHandle(file);
+        return false;
+    }
+    size = static_cast<size_t>(file_size.QuadPart);
+    // an empty file cannot be mapped
+    if (size > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0,
+                                     nullptr);
+        if (mapping != nullptr) {
+            view = static_cast<const char*>(
+                MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (view == nullptr) {
+            if (mapping != nullptr) {
+                CloseHandle(mapping);
+                mapping = nullptr;
+            }
+            CloseHandle(file);
+            size = 0;
+            return false;
+        }
+    }
+    // the mapping keeps the file open
+    CloseHandle(file);
+#elif defined(MYJSON_MMAP)
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat info;
+    if (::fstat(file, &info) != 0) {
+        ::close(file);
+        return false;
+    }
+    size = static_cast<size_t>(info.st_size);
+    // an empty file cannot be mapped
+    if (size > 0) {
+        void* address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (address == MAP_FAILED) {
+            ::close(file);
+            size = 0;
+            return false;
+        }
+        // the parsers read front to back
+        ::posix_madvise(address, size, POSIX_MADV_SEQUENTIAL);
+        view = static_cast<const char*>(address);
+    }
+    // the mapping keeps the file open
+    ::close(file);
+#else
+    if (!read_file(path, buffer)) {
+        return false;
+    }
+    view = buffer.data();
+    size = buffer.size();
+#endif
+    opened = true;
+    return true;
+}
+
+void mapped_file::close() {
+#if defined(_WIN32)
+    if (view != nullptr) {
+        UnmapViewOfFile(view);
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+#elif defined(MYJSON_MMAP)
+    if (view != nullptr) {
+        ::munmap(const_cast<char*>(view), size);
+    }
+#else
+    buffer.clear();
+#endif
+    view = nullptr;
+    size = 0;
+    opened = false;
+}
+
+// parse the file at path straight from its mapped pages. Strings are
+// always copied because the mapping ends with the call, document::
+// parse_file() keeps the mapping for zero_copy_strings.
+parse_result parse_file(const std::string& path, json& out,
+                        const parse_options& options = parse_options()) {
+    mapped_file file;
+    if (!file.open(path)) {
+        parse_result result;
+        result.error = parse_error::file_error;
+        return result;
+    }
+    parse_options file_options = options;
+    file_options.zero_copy_strings = false;
+    return parse(file.data(), out, file_options);
+}
+
+// throws if the file cannot be read or parsed
+json parse_file(const std::string& path,
+                const parse_options& options = parse_options()) {
+    json result;
+    parse_result status = parse_file(path, result, options);
+    if (status.error == parse_error::file_error) {
+        MYJSON_THROW(
+            std::runtime_error("At parse_file(): cannot read file " + path));
+    } else if (!status) {
+        MYJSON_THROW(std::runtime_error(parse_error_string(status)));
+    }
+    return result;
+}
+
+// Arena
+// monotonic buffer for json trees: allocating is a pointer bump, single
+// frees are no-ops and all memory is returned at once by release()
+class arena {
+   public:
+    explicit arena(size_t initial_size = 64 * 1024) {
+        buffer.emplace(initial_size, &upstream);
+        upstream.owner = &*buffer;
+    }
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+    ~arena() {
+        drop_keys();
+        buffer.reset();
+        if (block != nullptr) {
+            detail::arena_registry::instance().remove(block.get());
+        }
+    }
+
+    std::pmr::memory_resource* resource() { return &*buffer; }
+
+    // interned object keys of parse_options::intern_keys, in the arena
+    key_table& keys() {
+        if (key_storage == nullptr) {
+            void* storage = buffer->allocate(sizeof(key_table),
+                                             alignof(key_table));
+            key_storage = new (storage) key_table(&*buffer);
+        }
+        return *key_storage;
+    }
+
+    void release() {
+        drop_keys();
+        buffer->release();
+    }
+
+    // like release(), but keeps the memory for the next tree: the arena
+    // then works in one block as large as all it used before, so trees of
+    // similar size are built without allocating
+    void reset() {
+        drop_keys();
+        if (upstream.allocated == 0) {
+            // everything fit into the block
+            buffer->release();
+            return;
+        }
+        size_t size = block_size + upstream.allocated;
+        buffer.reset();
+        detail::arena_registry& registry = detail::arena_registry::instance();
+        if (block != nullptr) {
+            registry.remove(block.get());
+        }
+        block.reset();
+        block.reset(new char[size]);
+        block_size = size;
+        upstream.allocated = 0;
+        buffer.emplace(block.get(), block_size, &upstream);
+        registry.add(block.get(), block_size, &*buffer);
+    }
+
+   private:
+    // the heap, counting what the buffer takes from it beyond its block,
+    // with the blocks registered as memory of owner
+    class counted_resource : public std::pmr::memory_resource {
+       public:
+        size_t allocated = 0;  // since the last reset()
+        std::pmr::memory_resource* owner = nullptr;  // the buffer
+
+       private:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            allocated += bytes;
+            void* p = std::pmr::get_default_resource()->allocate(bytes,
+                                                                 alignment);
+            detail::arena_registry::instance().add(p, bytes, owner);
+            return p;
+        }
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+            detail::arena_registry::instance().remove(p);
+            std::pmr::get_default_resource()->deallocate(p, bytes, alignment);
+        }
+        bool do_is_equal(const memory_resource& other) const
+            noexcept override {
+            return this == &other;
+        }
+    };
+
+    counted_resource upstream;
+    std::unique_ptr<char[]> block;  // set by reset() once it needed more
+    size_t block_size = 0;
+    std::optional<std::pmr::monotonic_buffer_resource> buffer;
+    key_table* key_storage = nullptr;  // created in the arena by keys()
+
+    void drop_keys() {
+        if (key_storage != nullptr) {
+            key_storage->~key_table();
+            key_storage = nullptr;
+        }
+    }
+};
+
+// build the whole tree in memory, which must outlive the result
+json parse(std::string_view str, arena& memory,
+           const parse_options& options = parse_options()) {
+    parse_options arena_options = options;
+    arena_options.resource = memory.resource();
+    if (options.intern_keys) {
+        arena_options.keys = &memory.keys();
+    }
+    return parse(str, arena_options);
+}
+
+// Document
+// a json tree that lives entirely in its own arena. Destroying, clearing or
+// re-parsing a document releases the arena at once without visiting the
+// nodes. Values pushed, inserted or assigned anywhere into the tree are
+// copied into the arena, so nothing of it is left on the heap.
+//
+//     doc.root()["name"] = std::string(100, 'x');
+class document {
+   public:
+    explicit document(size_t initial_size = 64 * 1024)
+        : memory(new arena(initial_size)) {
+        reset_root();
+    }
+
+    json& root() { return *root_node; }
+    const json& root() const { return *root_node; }
+    std::pmr::memory_resource* resource() { return memory->resource(); }
+
+    // parse str into the document, replacing the previous tree
+    void parse(std::string_view str,
+               const parse_options& options = parse_options()) {
+        clear();
+        *root_node = myjson::parse(str, *memory, options);
+    }
+
+    // parse a memory-mapped file, the document keeps the mapping, so with
+    // zero_copy_strings strings point into the file's pages
+    void parse_file(const std::string& path,
+                    const parse_options& options = parse_options()) {
+        clear();
+        if (file == nullptr) {
+            file.reset(new mapped_file());
+        }
+        if (!file->open(path)) {
+            MYJSON_THROW(std::runtime_error(
+                "At document::parse_file(): cannot read file " + path));
+        }
+        *root_node = myjson::parse(file->data(), *memory, options);
+    }
+
+    void clear() {
+        memory->release();
+        reset_root();
+        if (file != nullptr) {
+            file->close();
+        }
+    }
+
+   private:
+    std::unique_ptr<arena> memory;
+    json* root_node = nullptr;  // allocated in memory, never destroyed
+    std::unique_ptr<mapped_file> file;  // set by parse_file()
+
+    void reset_root() {
+        void* storage = memory->resource()->allocate(sizeof(json),
+                                                     alignof(json));
+        root_node = new (storage) json();
+    }
+};
+
+// Parser
+// parses a stream of documents, one after another, on one thread. The
+// parser keeps its arena, structural index, scratch strings and container
+// stacks between calls, so once they have grown to the size of the
+// messages parsing allocates nothing. Each result lives in the parser's
+// arena and is valid until the next parse(). Like in a document, values
+// assigned into a result are copied into the arena.
+class parser {
+   public:
+    explicit parser(const parse_options& options = parse_options(),
+                    size_t initial_size = 64 * 1024)
+        : options(options),
+          memory(initial_size),
+          builder(std::string_view(), this->options, empty),
+          reader(std::string_view(), 0, builder, options.max_depth),
+          structural(std::string_view(), nullptr, this->options) {
+        this->options.resource = memory.resource();
+        reset_root();
+    }
+    parser(const parser&) = delete;
+    parser& operator=(const parser&) = delete;
+
+    // parse str without throwing, replacing the previous result, like
+    // parse(str, out). root() is unspecified on failure.
+    parse_result parse(std::string_view str) {
+        MYJSON_STATS_SCOPE(stats_operation::parse);
+        memory.reset();
+        reset_root();
+        options.keys = options.intern_keys ? &memory.keys() : nullptr;
+        if (str.empty()) {
+            return make_parse_result(str, parse_error::unexpected_end, 0);
+        }
+        parse_error error;
+        size_t offset = 0;
+        // like parse(str, out), the scanning parser reports an
+        // unterminated string
+        if (options.use_structural_index && str.size() < UINT32_MAX &&
+            build_structural_index(str, index) == parse_error::none) {
+            structural.reset(str, index.positions.data());
+            error = structural.parse(*root_node);
+            offset = error != parse_error::none ? structural.error_offset()
+                                                : structural.position();
+        } else {
+            builder.reset(str, *root_node);
+            reader.reset(str, 0);
+            error = reader.parse();
+            offset = reader.position();
+        }
+        if (error == parse_error::none) {
+            error = check_trailing(str, offset);
+        }
+        if (error != parse_error::none) {
+            MYJSON_STATS_ADD(bytes_scanned, offset);
+            return make_parse_result(str, error, offset);
+        }
+        MYJSON_STATS_ADD(bytes_scanned, str.size());
+        return parse_result();
+    }
+
+    json& root() { return *root_node; }
+    const json& root() const { return *root_node; }
+    std::pmr::memory_resource* resource() { return memory.resource(); }
+
+   private:
+    parse_options options;  // allocating from memory
+    arena memory;
+    json empty;  // target of builder before the first parse()
+    json* root_node = nullptr;  // allocated in memory, never destroyed
+    structural_index index;
+    detail::dom_builder builder;
+    detail::sax_reader<detail::dom_builder> reader;
+    structural_parser structural;
+
+    void reset_root() {
+        void* storage = memory.resource()->allocate(sizeof(json),
+                                                    alignof(json));
+        root_node = new (storage) json();
+    }
+};
+
+// NDJSON
+// options of parse_ndjson(): records are separated by '\n', blank lines
+// are skipped
+struct ndjson_options {
+    // per record options, resource and keys are replaced by the arena of
+    // each chunk
+    parse_options parse;
+    // worker threads, 0 for one per core
+    size_t threads = 0;
+    // the input is split at the first newline after every chunk_size bytes
+    size_t chunk_size = 1 << 20;
+    // deliver records in input order on the calling thread. Otherwise the
+    // callback runs on the worker threads as soon as a chunk is parsed, it
+    // must then be thread-safe and must not throw.
+    bool ordered = true;
+};
+
+// called once per record. The record lives in the arena of its chunk and is
+// only valid during the call.
+using ndjson_callback = std::function<void(json& record)>;
+
+namespace detail {
+
+// pieces of str of about chunk_size bytes that end at a newline
+std::vector<std::string_view> split_ndjson(std::string_view str,
+                                           size_t chunk_size) {
+    std::vector<std::string_view> chunks;
+    size_t start = 0;
+    while (start < str.size()) {
+        size_t end = str.size();
+        if (str.size() - start > chunk_size) {
+            size_t newline = str.find('\n', start + chunk_size);
+            if (newline != std::string_view::npos) {
+                end = newline + 1;
+            }
+        }
+        chunks.push_back(str.substr(start, end - start));
+        start = end;
+    }
+    return chunks;
+}
+
+// parses chunks on a pool of threads, each chunk into its own arena
+class ndjson_batch {
+   public:
+    ndjson_batch(std::string_view str, const ndjson_options& options,
+                 const ndjson_callback& callback)
+        : str(str),
+          chunks(split_ndjson(str, std::max<size_t>(options.chunk_size, 1))),
+          options(options),
+          callback(callback) {
+#if defined(MYJSON_NO_THREADS)
+        threads = 1;
+#else
+        threads = options.threads != 0 ? options.threads
+                                       : std::thread::hardware_concurrency();
+#endif
+        threads = std::max<size_t>(1, std::min(threads, chunks.size()));
+        // ordered mode lets workers run this many chunks ahead
+        window = options.ordered ? 2 * threads : threads;
+        for (size_t i = 0; i < window; i++) {
+            slots.emplace_back(new slot(options.parse));
+        }
+    }
+
+    parse_result run() {
+        if (threads == 1) {
+            for (size_t chunk = 0; chunk < chunks.size() && !stop; chunk++) {
+                parse_chunk(chunk, *slots[0]);
+                finish_chunk(chunk, *slots[0]);
+            }
+        } else {
+            run_parallel();
+        }
+        if (error != parse_error::none) {
+            return make_parse_result(str, error, error_offset);
+        }
+        return parse_result();
+    }
+
+   private:
+    // a chunk being parsed or waiting to be delivered
+    // a chunk's arena, and the builder and reader kept for its records
+    struct slot {
+        explicit slot(const parse_options& parse)
+            : options(parse),
+              builder(std::string_view(), options, empty),
+              reader(std::string_view(), 0, builder, parse.max_depth) {
+            options.resource = memory.resource();
+        }
+
+        arena memory;
+        parse_options options;  // allocating from memory
+        json empty;  // target of builder before the first record
+        dom_builder builder;
+        sax_reader<dom_builder> reader;
+        std::vector<json*> records;  // in memory, never destroyed
+        parse_error error = parse_error::none;
+        size_t error_offset = 0;
+        bool ready = false;
+    };
+
+    std::string_view str;
+    std::vector<std::string_view> chunks;
+    const ndjson_options& options;
+    const ndjson_callback& callback;
+    size_t threads = 1;
+    size_t window = 1;
+    std::vector<std::unique_ptr<slot>> slots;
+
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<bool> stop{false};
+    // the first error in input order
+    size_t error_chunk = SIZE_MAX;
+    parse_error error = parse_error::none;
+    size_t error_offset = 0;
+
+#if !defined(MYJSON_NO_THREADS)
+    std::mutex error_mutex;
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t delivered = 0;  // ordered: chunks handed to the callback
+
+    // joins the workers, and stops them first if the callback throws
+    struct worker_pool {
+        ndjson_batch& batch;
+        std::vector<std::thread> workers;
+
+        void join() {
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+            workers.clear();
+        }
+
+        ~worker_pool() {
+            if (workers.empty()) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                batch.stop = true;
+            }
+            batch.changed.notify_all();
+            join();
+        }
+    };
+
+    void run_parallel() {
+        worker_pool pool{*this, {}};
+        for (size_t i = 0; i < threads; i++) {
+            pool.workers.emplace_back([this, i] { work(*slots[i]); });
+        }
+        if (!options.ordered) {
+            pool.join();
+            return;
+        }
+        for (size_t chunk = 0; chunk < chunks.size() && !stop; chunk++) {
+            slot& current = *slots[chunk % window];
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return current.ready; });
+            }
+            finish_chunk(chunk, current);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current.ready = false;
+                delivered++;
+            }
+            changed.notify_all();
+        }
+    }
+
+    void work(slot& own) {
+        while (!stop) {
+            size_t chunk = next_chunk++;
+            if (chunk >= chunks.size()) {
+                return;
+            }
+            if (!options.ordered) {
+                parse_chunk(chunk, own);
+                finish_chunk(chunk, own);
+                continue;
+            }
+            slot* target;
+            {
+                // the slot is free once the chunk window before it is out
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] {
+                    return stop || chunk < delivered + window;
+                });
+                if (stop) {
+                    return;
+                }
+                target = slots[chunk % window].get();
+            }
+            parse_chunk(chunk, *target);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                target->ready = true;
+            }
+            changed.notify_all();
+        }
+    }
+#else
+    void run_parallel() {}
+#endif
+
+    // parse every line of the chunk, up to the first error
+    void parse_chunk(size_t chunk, slot& target) {
+        std::string_view text = chunks[chunk];
+        target.options.keys =
+            options.parse.intern_keys ? &target.memory.keys() : nullptr;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = std::min(text.find('\n', start), text.size());
+            std::string_view line = text.substr(start, end - start);
+            size_t index = 0;
+            skip_whitespace(line, index);
+            if (index < line.size()) {
+                void* storage = target.memory.resource()->allocate(
+                    sizeof(json), alignof(json));
+                json* record = new (storage) json();
+                target.builder.reset(line, *record);
+                target.reader.reset(line, index);
+                parse_error code = target.reader.parse();
+                index = target.reader.position();
+                skip_whitespace(line, index);
+                if (code == parse_error::none && index != line.size()) {
+                    code = parse_error::trailing_characters;
+                }
+                if (code != parse_error::none) {
+                    target.error = code;
+                    target.error_offset = line.data() - str.data() + index;
+                    return;
+                }
+                target.records.push_back(record);
+            }
+            start = end + 1;
+        }
+    }
+
+    // deliver the records of a parsed chunk and free its arena
+    void finish_chunk(size_t chunk, slot& target) {
+        for (json* record : target.records) {
+            callback(*record);
+        }
+        parse_error code = target.error;
+        target.records.clear();
+        target.error = parse_error::none;
+        target.memory.release();
+        if (code == parse_error::none) {
+            return;
+        }
+#if !defined(MYJSON_NO_THREADS)
+        std::lock_guard<std::mutex> lock(error_mutex);
+#endif
+        if (chunk < error_chunk) {
+            error_chunk = chunk;
+            error = code;
+            error_offset = target.error_offset;
+        }
+        stop = true;
+    }
+};
+
+}  // namespace detail
+
+// parse newline delimited json, chunks of str are parsed in parallel and
+// each record is passed to callback. Stops at the first invalid record,
+// in ordered mode all records before it have been delivered.
+parse_result parse_ndjson(std::string_view str, const ndjson_callback& callback,
+                          const ndjson_options& options = ndjson_options()) {
+    detail::ndjson_batch batch(str, options, callback);
+    return batch.run();
+}
+
+// map path and parse it as newline delimited json, records may point into
+// the mapping during the callback
+parse_result parse_ndjson_file(
+    const std::string& path, const ndjson_callback& callback,
+    const ndjson_options& options = ndjson_options()) {
+    mapped_file file;
+    if (!file.open(path)) {
+        parse_result result;
+        result.error = parse_error::file_error;
+        return result;
+    }
+    return parse_ndjson(file.data(), callback, options);
+}
+
+// Parallel dump and parse
+// options of dump_parallel() and parse_parallel()
+struct parallel_options {
+    // worker threads, 0 for one per core
+    size_t threads = 0;
+    // parse_parallel() hands each thread about this many bytes of array
+    // elements at a time, smaller inputs are parsed on the calling thread
+    size_t chunk_size = 1 << 20;
+};
+
+namespace detail {
+
+size_t thread_count(size_t requested) {
+#if defined(MYJSON_NO_THREADS)
+    (void)requested;
+    return 1;
+#else
+    size_t threads =
+        requested != 0 ? requested : std::thread::hardware_concurrency();
+    return std::max<size_t>(threads, 1);
+#endif
+}
+
+// run task(0) ... task(count - 1) on up to threads threads, the calling
+// thread included. The tasks must not throw.
+void run_tasks(size_t count, size_t threads,
+               const std::function<void(size_t)>& task) {
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i = next++; i < count; i = next++) {
+            task(i);
+        }
+    };
+#if !defined(MYJSON_NO_THREADS)
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(threads, count); i++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+#else
+    (void)threads;
+    work();
+#endif
+}
+
+// the top-level array or object of value written as separate parts, each
+// by its own task. Joined in order and wrapped in brackets they are the
+// output of dump().
+std::vector<std::string> dump_parts(const json& value,
+                                    const parallel_options& parallel,
+                                    const dump_options& options) {
+    const char* comma = options.compact ? "," : ", ";
+    const char* colon = options.compact ? ":" : ": ";
+    size_t threads = thread_count(parallel.threads);
+    std::vector<const _object::value_type*> members;
+    size_t count;
+    if (value.get_type() == json::Type::_array) {
+        count = value.as_array().size();
+    } else {
+        for (const auto& member : value.as_object()) {
+            members.push_back(&member);
+        }
+        count = members.size();
+    }
+    // a few parts per thread even out elements of different sizes
+    size_t parts = std::min(count, 4 * threads);
+    std::vector<std::string> result(parts);
+    run_tasks(parts, threads, [&](size_t part) {
+        std::string& out = result[part];
+        dump_writer writer{out, nullptr};
+        size_t first = count * part / parts;
+        size_t last = count * (part + 1) / parts;
+        for (size_t i = first; i < last; i++) {
+            if (i != 0) {
+                out += comma;
+            }
+            if (members.empty()) {
+                dump_value(value.as_array()[i], writer, options);
+            } else {
+                escape_string(members[i]->first, out);
+                out += colon;
+                dump_value(members[i]->second, writer, options);
+            }
+        }
+    });
+    return result;
+}
+
+// offsets of the top-level array elements of str, each up to the ',' or
+// ']' after it. Strings and nesting are tracked but not validated, that
+// is left to the element parsers. False if str is no complete array.
+bool split_array(std::string_view str, size_t open,
+                 std::vector<size_t>& starts, size_t& close) {
+    starts.push_back(open + 1);
+    size_t depth = 0;
+    for (size_t i = open + 1; i < str.size(); i++) {
+        char c = str[i];
+        if (c == '\"') {
+            // skip to the closing quote, past any escaped ones
+            while (true) {
+                const void* quote =
+                    std::memchr(str.data() + i + 1, '\"', str.size() - i - 1);
+                if (quote == nullptr) {
+                    return false;
+                }
+                i = static_cast<const char*>(quote) - str.data();
+                size_t backslashes = 0;
+                while (str[i - 1 - backslashes] == '\\') {
+                    backslashes++;
+                }
+                if (backslashes % 2 == 0) {
+                    break;
+                }
+            }
+        } else if (c == '[' || c == '{') {
+            depth++;
+        } else if (c == ']' || c == '}') {
+            if (depth == 0) {
+                close = i;
+                return c == ']';
+            }
+            depth--;
+        } else if (c == ',' && depth == 0) {
+            starts.push_back(i + 1);
+        }
+    }
+    return false;
+}
+
+}  // namespace detail
+
+// dump() of a large array or object, its elements or members are written
+// in parallel into separate buffers that are joined at the end
+std::string dump_parallel(const json& value,
+                          const parallel_options& parallel = parallel_options(),
+                          const dump_options& options = dump_options()) {
+    json::Type type = value.get_type();
+    if (type != json::Type::_array && type != json::Type::_object) {
+        return value.dump(options);
+    }
+    std::vector<std::string> parts =
+        detail::dump_parts(value, parallel, options);
+    size_t size = 2;
+    for (const std::string& part : parts) {
+        size += part.size();
+    }
+    std::string result;
+    result.reserve(size);
+    result += type == json::Type::_array ? '[' : '{';
+    for (const std::string& part : parts) {
+        result += part;
+    }
+    result += type == json::Type::_array ? ']' : '}';
+    return result;
+}
+
+void dump_parallel_to(const json& value, output_sink& sink,
+                      const parallel_options& parallel = parallel_options(),
+                      const dump_options& options = dump_options()) {
+    json::Type type = value.get_type();
+    if (type != json::Type::_array && type != json::Type::_object) {
+        value.dump_to(sink, options);
+        return;
+    }
+    std::vector<std::string> parts =
+        detail::dump_parts(value, parallel, options);
+    sink.write(type == json::Type::_array ? "[" : "{", 1);
+    for (const std::string& part : parts) {
+        sink.write(part.data(), part.size());
+    }
+    sink.write(type == json::Type::_array ? "]" : "}", 1);
+}
+
+// parse() of a large top-level array: a fast scan finds the elements, which
+// are then parsed in parallel straight into their place in out. Anything
+// else, and any invalid input, goes through parse(), so results and errors
+// are the same. The workers allocate from the default heap at the same
+// time, a tree for another resource, or for a node of an arena, is copied
+// into place once they are done. Keys are not interned.
+parse_result parse_parallel(
+    std::string_view str, json& out,
+    const parallel_options& parallel = parallel_options(),
+    const parse_options& options = parse_options()) {
+    size_t threads = detail::thread_count(parallel.threads);
+    size_t chunk_size = std::max<size_t>(parallel.chunk_size, 1);
+    size_t open = 0;
+    skip_whitespace(str, open);
+    std::vector<size_t> starts;
+    size_t close = 0;
+    if (threads == 1 || str.size() - open < 2 * chunk_size ||
+        peek(str, open) != '[' || options.max_depth == 0 ||
+        !detail::split_array(str, open, starts, close)) {
+        return parse(str, out, options);
+    }
+    size_t end = close + 1;
+    if (check_trailing(str, end) != parse_error::none) {
+        return parse(str, out, options);
+    }
+    // [] or [ ] has one blank element
+    size_t count = starts.size();
+    if (count == 1) {
+        size_t index = starts[0];
+        skip_whitespace(str, index);
+        if (index == close) {
+            count = 0;
+        }
+    }
+    parse_options element_options = options;
+    element_options.max_depth = options.max_depth - 1;
+    element_options.keys = nullptr;
+    element_options.resource = std::pmr::get_default_resource();
+    // an arena is not thread-safe, neither may be any other resource
+    bool copy = options.memory() != element_options.resource ||
+                detail::arena_registry::instance().find(&out) != nullptr;
+    json heap;
+    json& tree = copy ? heap : out;
+    tree = json(_array(element_options.memory()));
+    _array& elements = tree.as_array();
+    elements.resize(count);
+    // runs of elements of about chunk_size bytes
+    std::vector<size_t> tasks;
+    for (size_t i = 0; i < count; i++) {
+        if (tasks.empty() || starts[i] - starts[tasks.back()] >= chunk_size) {
+            tasks.push_back(i);
+        }
+    }
+    std::atomic<bool> failed{false};
+    detail::run_tasks(tasks.size(), threads, [&](size_t task) {
+        size_t first = tasks[task];
+        size_t last = task + 1 < tasks.size() ? tasks[task + 1] : count;
+        for (size_t i = first; i < last && !failed; i++) {
+            size_t end = i + 1 < count ? starts[i + 1] - 1 : close;
+            std::string_view text = str.substr(0, end);
+            detail::dom_builder builder(str, element_options, elements[i]);
+            detail::sax_reader<detail::dom_builder> reader(
+                text, starts[i], builder, element_options.max_depth);
+            size_t index = 0;
+            if (reader.parse() == parse_error::none) {
+                index = reader.position();
+                skip_whitespace(text, index);
+            }
+            if (index != end) {
+                failed = true;
+            }
+        }
+    });
+    if (failed) {
+        // parse again to find the first error
+        return parse(str, out, options);
+    }
+    if (copy) {
+        out = json(std::move(heap), json::allocator_type(options.memory()));
+    }
+    return parse_result();
+}
+
+// throws on errors
+json parse_parallel(std::string_view str,
+                    const parallel_options& parallel = parallel_options(),
+                    const parse_options& options = parse_options()) {
+    json result;
+    parse_result status = parse_parallel(str, result, parallel, options);
+    if (!status) {
+        MYJSON_THROW(std::runtime_error(parse_error_string(status)));
+    }
+    return result;
+}
+
+// Struct binding
+// MYJSON_DEFINE(Type, member...) next to a struct, in its namespace, lists
+// the members that dump(value) writes and parse_into() reads, in order,
+// straight between text and the struct without a json tree. Members may
+// be bool, numbers, strings, json, std::optional, std::vector,
+// std::map<std::string, ...>, other bound types, or types with to_json()
+// and from_json(), which go through a json. At most 32 members.
+#define MYJSON_DEFINE(Type, ...)                                  \
+    constexpr auto myjson_fields(const Type*) {                   \
+        return std::make_tuple(MYJSON_FIELDS(Type, __VA_ARGS__)); \
+    }
+
+#define MYJSON_FIELD(Type, name) \
+    ::myjson::field<Type, decltype(Type::name)> { #name, &Type::name }
+#define MYJSON_EXPAND(x) x
+#define MYJSON_GET_FIELDS(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, \
+    _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26,    \
+    _27, _28, _29, _30, _31, _32, NAME, ...) NAME
+#define MYJSON_FIELDS(Type, ...)                                             \
+    MYJSON_EXPAND(MYJSON_GET_FIELDS(__VA_ARGS__, MYJSON_FIELDS_32,           \
+        MYJSON_FIELDS_31, MYJSON_FIELDS_30, MYJSON_FIELDS_29,                \
+        MYJSON_FIELDS_28, MYJSON_FIELDS_27, MYJSON_FIELDS_26,                \
+        MYJSON_FIELDS_25, MYJSON_FIELDS_24, MYJSON_FIELDS_23,                \
+        MYJSON_FIELDS_22, MYJSON_FIELDS_21, MYJSON_FIELDS_20,                \
+        MYJSON_FIELDS_19, MYJSON_FIELDS_18, MYJSON_FIELDS_17,                \
+        MYJSON_FIELDS_16, MYJSON_FIELDS_15, MYJSON_FIELDS_14,                \
+        MYJSON_FIELDS_13, MYJSON_FIELDS_12, MYJSON_FIELDS_11,                \
+        MYJSON_FIELDS_10, MYJSON_FIELDS_9, MYJSON_FIELDS_8, MYJSON_FIELDS_7, \
+        MYJSON_FIELDS_6, MYJSON_FIELDS_5, MYJSON_FIELDS_4, MYJSON_FIELDS_3,  \
+        MYJSON_FIELDS_2, MYJSON_FIELDS_1)(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_1(Type, name) MYJSON_FIELD(Type, name)
+#define MYJSON_FIELDS_2(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_1(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_3(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_2(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_4(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_3(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_5(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_4(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_6(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_5(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_7(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_6(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_8(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_7(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_9(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_8(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_10(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_9(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_11(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_10(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_12(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_11(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_13(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_12(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_14(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_13(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_15(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_14(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_16(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_15(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_17(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_16(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_18(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_17(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_19(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_18(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_20(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_19(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_21(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_20(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_22(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_21(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_23(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_22(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_24(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_23(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_25(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_24(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_26(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_25(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_27(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_26(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_28(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_27(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_29(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_28(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_30(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_29(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_31(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_30(Type, __VA_ARGS__))
+#define MYJSON_FIELDS_32(Type, name, ...) \
+    MYJSON_FIELD(Type, name), MYJSON_EXPAND(MYJSON_FIELDS_31(Type, __VA_ARGS__))
+
+// one member of a bound struct
+template <class Class, class Member>
+struct field {
+    std::string_view name;
+    Member Class::*member;
+};
+
+namespace detail {
+
+template <class T, class = void>
+struct is_bound : std::false_type {};
+template <class T>
+struct is_bound<T, std::void_t<decltype(myjson_fields(
+                       static_cast<const T*>(nullptr)))>> : std::true_type {};
+
+template <class T>
+struct is_optional : std::false_type {};
+template <class T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template <class T>
+struct is_vector : std::false_type {};
+template <class T, class Allocator>
+struct is_vector<std::vector<T, Allocator>> : std::true_type {};
+
+template <class T>
+struct is_string_map : std::false_type {};
+template <class T, class Compare, class Allocator>
+struct is_string_map<std::map<std::string, T, Compare, Allocator>>
+    : std::true_type {};
+
+template <class T>
+constexpr auto fields_of() {
+    return myjson_fields(static_cast<const T*>(nullptr));
+}
+
+template <class T>
+void write_bound(const T& value, std::string& out,
+                 const dump_options& options) {
+    if constexpr (std::is_same_v<T, json>) {
+        dump_writer writer{out, nullptr};
+        dump_value(value, writer, options);
+    } else if constexpr (std::is_same_v<T, bool>) {
+        out += value ? "true" : "false";
+    } else if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>) {
+        char buffer[24];
+        char* end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+        out.append(buffer, end);
+    } else if constexpr (std::is_integral_v<T>) {
+        append_int(out, static_cast<_int>(value));
+    } else if constexpr (std::is_floating_point_v<T>) {
+        append_float(out, static_cast<_float>(value));
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        escape_string(value, out);
+    } else if constexpr (is_optional<T>::value) {
+        if (value) {
+            write_bound(*value, out, options);
+        } else {
+            out += "null";
+        }
+    } else if constexpr (is_vector<T>::value) {
+        out += '[';
+        for (size_t i = 0; i < value.size(); i++) {
+            if (i != 0) {
+                out += options.compact ? "," : ", ";
+            }
+            write_bound(value[i], out, options);
+        }
+        out += ']';
+    } else if constexpr (is_string_map<T>::value) {
+        out += '{';
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            if (it != value.begin()) {
+                out += options.compact ? "," : ", ";
+            }
+            escape_string(it->first, out);
+            out += options.compact ? ":" : ": ";
+            write_bound(it->second, out, options);
+        }
+        out += '}';
+    } else if constexpr (is_bound<T>::value) {
+        out += '{';
+        bool first = true;
+        std::apply(
+            [&](const auto&... fields) {
+                auto write_field = [&](const auto& field) {
+                    if (!first) {
+                        out += options.compact ? "," : ", ";
+                    }
+                    first = false;
+                    escape_string(field.name, out);
+                    out += options.compact ? ":" : ": ";
+                    write_bound(value.*(field.member), out, options);
+                };
+                (write_field(fields), ...);
+            },
+            fields_of<T>());
+        out += '}';
+    } else {
+        json j;
+        to_json(j, value);
+        dump_writer writer{out, nullptr};
+        dump_value(j, writer, options);
+    }
+}
+
+// reads values of bound types straight from the text. A value of another
+// json type than the member expects is skipped and leaves the member
+// unchanged, like from_json(), numbers convert between int and float. A
+// number out of the member's range leaves it unchanged as well.
+class bound_reader {
+   public:
+    bound_reader(std::string_view str, const parse_options& options)
+        : str(str), options(options) {}
+
+    template <class T>
+    parse_error read(T& out) {
+        skip_whitespace(str, index);
+        char c = peek(str, index);
+        if constexpr (std::is_same_v<T, json>) {
+            out = json();
+            dom_builder builder(str, options, out);
+            sax_reader<dom_builder> reader(str, index, builder,
+                                           remaining_depth());
+            parse_error error = reader.parse();
+            index = reader.position();
+            return error;
+        } else if constexpr (is_optional<T>::value) {
+            if (c == 'n') {
+                out.reset();
+                return skip_value();
+            }
+            if (!out) {
+                out.emplace();
+            }
+            return read(*out);
+        } else if constexpr (std::is_same_v<T, bool>) {
+            if (c != 't' && c != 'f') {
+                return skip_value();
+            }
+            json scalar;
+            parse_error error = c == 't' ? parse_true(str, index, scalar)
+                                         : parse_false(str, index, scalar);
+            if (error == parse_error::none) {
+                out = scalar.as_bool();
+            }
+            return error;
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            if (c != '-' && !std::isdigit(static_cast<unsigned char>(c))) {
+                return skip_value();
+            }
+            size_t start = index;
+            json scalar;
+            parse_error error = parse_number(str, index, scalar);
+            if (error != parse_error::none) {
+                return error;
+            }
+            if constexpr (std::is_integral_v<T>) {
+                // exact for the whole range of T, unsigned 64-bit included
+                // from_chars stores the digits before an exponent or '.'
+                const char* end = str.data() + index;
+                T value;
+                auto converted =
+                    std::from_chars(str.data() + start, end, value);
+                if (converted.ec == std::errc() && converted.ptr == end) {
+                    out = value;
+                    return parse_error::none;
+                }
+            }
+            convert_number(scalar, out);
+            return parse_error::none;
+        } else if constexpr (std::is_convertible_v<const T&,
+                                                   std::string_view>) {
+            if (c != '\"') {
+                return skip_value();
+            }
+            std::string_view body;
+            parse_error error = read_string(body);
+            if (error == parse_error::none) {
+                out.assign(body.data(), body.size());
+            }
+            return error;
+        } else if constexpr (is_vector<T>::value) {
+            if (c != '[') {
+                return skip_value();
+            }
+            return read_array(out);
+        } else if constexpr (is_string_map<T>::value ||
+                             is_bound<T>::value) {
+            if (c != '{') {
+                return skip_value();
+            }
+            return read_object(out);
+        } else {
+            json j;
+            parse_error error = read(j);
+            if (error == parse_error::none) {
+                from_json(j, out);
+            }
+            return error;
+        }
+    }
+
+    // after the value, or at the error
+    size_t position() const { return index; }
+
+   private:
+    std::string_view str;
+    const parse_options& options;
+    size_t index = 0;
+    size_t depth = 0;      // open arrays and objects
+    std::string scratch;   // decoded strings with escapes
+
+    size_t remaining_depth() const {
+        return options.max_depth > depth ? options.max_depth - depth : 0;
+    }
+
+    // validate the value and ignore it
+    parse_error skip_value() {
+        sax_handler ignore;
+        sax_reader<sax_handler> reader(str, index, ignore, remaining_depth());
+        parse_error error = reader.parse();
+        index = reader.position();
+        return error;
+    }
+
+    // the body of the string at index, decoded into scratch if it has
+    // escapes
+    parse_error read_string(std::string_view& out) {
+        size_t start = index + 1;
+        size_t end = start;
+        bool has_escape = false;
+        while (end < str.size() && str[end] != '\"') {
+            if (str[end] == '\\') {
+                has_escape = true;
+                end++;
+            }
+            end++;
+        }
+        if (end >= str.size()) {
+            index = str.size();
+            return parse_error::unexpected_end;
+        }
+        out = str.substr(start, end - start);
+        if (has_escape) {
+            size_t bad_escape = try_unescape_string(out, scratch);
+            if (bad_escape != std::string_view::npos) {
+                index = start + bad_escape;
+                return parse_error::invalid_escape;
+            }
+            out = scratch;
+        }
+        index = end + 1;
+        return parse_error::none;
+    }
+
+    template <class T>
+    parse_error read_array(T& out) {
+        if (depth >= options.max_depth) {
+            return error_at(str, index, parse_error::too_deep);
+        }
+        index++;
+        out.clear();
+        skip_whitespace(str, index);
+        if (peek(str, index) == ']') {
+            index++;
+            return parse_error::none;
+        }
+        depth++;
+        while (true) {
+            out.emplace_back();
+            parse_error error = read(out.back());
+            if (error != parse_error::none) {
+                return error;
+            }
+            skip_whitespace(str, index);
+            if (peek(str, index) == ',') {
+                index++;
+            } else if (peek(str, index) == ']') {
+                index++;
+                depth--;
+                return parse_error::none;
+            } else {
+                return error_at(str, index,
+                                parse_error::expected_comma_or_bracket);
+            }
+        }
+    }
+
+    // members missing from the text keep their value, unknown keys are
+    // skipped
+    template <class T>
+    parse_error read_object(T& out) {
+        if (depth >= options.max_depth) {
+            return error_at(str, index, parse_error::too_deep);
+        }
+        index++;
+        skip_whitespace(str, index);
+        if (peek(str, index) == '}') {
+            index++;
+            return parse_error::none;
+        }
+        depth++;
+        while (true) {
+            skip_whitespace(str, index);
+            if (peek(str, index) != '\"') {
+                return error_at(str, index, parse_error::expected_key);
+            }
+            std::string_view key;
+            parse_error error = read_string(key);
+            if (error != parse_error::none) {
+                return error;
+            }
+            skip_whitespace(str, index);
+            if (peek(str, index) != ':') {
+                return error_at(str, index, parse_error::expected_colon);
+            }
+            index++;
+            error = read_member(out, key);
+            if (error != parse_error::none) {
+                return error;
+            }
+            skip_whitespace(str, index);
+            if (peek(str, index) == ',') {
+                index++;
+            } else if (peek(str, index) == '}') {
+                index++;
+                depth--;
+                return parse_error::none;
+            } else {
+                return error_at(str, index,
+                                parse_error::expected_comma_or_brace);
+            }
+        }
+    }
+
+    template <class T>
+    parse_error read_member(T& out, std::string_view key) {
+        if constexpr (is_string_map<T>::value) {
+            return read(out[std::string(key)]);
+        } else {
+            // the key may live in scratch, so it is matched before reading
+            parse_error error = parse_error::none;
+            bool found = false;
+            std::apply(
+                [&](const auto&... fields) {
+                    auto match = [&](const auto& field) {
+                        if (!found && field.name == key) {
+                            found = true;
+                            error = read(out.*(field.member));
+                        }
+                    };
+                    (match(fields), ...);
+                },
+                fields_of<T>());
+            return found ? error : skip_value();
+        }
+    }
+};
+
+}  // namespace detail
+
+// write value as json without building a json tree, value is a bound
+// struct or any other type write_bound() takes
+template <class T>
+std::string dump(const T& value, const dump_options& options = dump_options()) {
+    std::string result;
+    detail::write_bound(value, result, options);
+    return result;
+}
+
+// read str straight into out without building a json tree, members that
+// are not in str keep their value
+template <class T>
+parse_result parse_into(std::string_view str, T& out,
+                        const parse_options& options = parse_options()) {
+    detail::bound_reader reader(str, options);
+    parse_error error = reader.read(out);
+    if (error != parse_error::none) {
+        return make_parse_result(str, error, reader.position());
+    }
+    return parse_result();
+}
+
+// throws on errors
+template <class T>
+T parse_into(std::string_view str,
+             const parse_options& options = parse_options()) {
+    T result{};
+    parse_result status = parse_into(str, result, options);
+    if (!status) {
+        MYJSON_THROW(std::runtime_error(parse_error_string(status)));
+    }
+    return result;
+}
+
+// Binary formats
+// CBOR (RFC 8949) and MessagePack encodings of json values, for services
+// that do not need text. Containers are length-prefixed, so decoding
+// sizes each _array up front. Byte strings, extension types and indefinite
+// lengths are not supported, CBOR tags are skipped.
+namespace detail {
+
+// appends bytes to a buffer and, when there is a sink, hands it every
+// full chunk, like dump_writer
+struct byte_writer {
+    static constexpr size_t chunk_size = 16384;
+
+    std::vector<uint8_t>& out;
+    output_sink* sink;
+
+    void put(uint8_t byte) { out.push_back(byte); }
+
+    // value in big-endian byte order
+    template <class T>
+    void put_big_endian(T value) {
+        for (size_t i = sizeof(T); i-- > 0;) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void append(std::string_view bytes) {
+        out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+
+    void flush_if_full() {
+        if (sink != nullptr && out.size() >= chunk_size) {
+            flush();
+        }
+    }
+
+    void flush() {
+        sink->write(reinterpret_cast<const char*>(out.data()), out.size());
+        out.clear();
+    }
+};
+
+// true if value survives a round trip through float
+bool fits_float(_float value) {
+    return static_cast<_float>(static_cast<float>(value)) == value;
+}
+
+uint32_t float_bits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+uint64_t double_bits(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+class cbor_encoder {
+   public:
+    explicit cbor_encoder(byte_writer& writer) : writer(writer) {}
+
+    void scalar(const json& value) {
+        json::Type type = value.get_type();
+        if (type == json::Type::_null) {
+            writer.put(0xF6);
+        } else if (type == json::Type::_bool) {
+            writer.put(value.as_bool() ? 0xF5 : 0xF4);
+        } else if (type == json::Type::_int) {
+            _int number = value.as_int();
+            if (number >= 0) {
+                header(0, static_cast<uint64_t>(number));
+            } else {
+                // -1 - n without overflowing at INT64_MIN
+                header(1, ~static_cast<uint64_t>(number));
+            }
+        } else if (type == json::Type::_float) {
+            _float number = value.as_float();
+            if (fits_float(number)) {
+                writer.put(0xFA);
+                writer.put_big_endian(float_bits(static_cast<float>(number)));
+            } else {
+                writer.put(0xFB);
+                writer.put_big_endian(double_bits(number));
+            }
+        } else {
+            string(value.get_string_view());
+        }
+    }
+    void string(std::string_view str) {
+        header(3, str.size());
+        writer.append(str);
+    }
+    void begin_array(size_t size) { header(4, size); }
+    void begin_object(size_t size) { header(5, size); }
+
+   private:
+    byte_writer& writer;
+
+    // major type and its argument in the shortest form
+    void header(uint8_t major, uint64_t argument) {
+        uint8_t type = static_cast<uint8_t>(major << 5);
+        if (argument < 24) {
+            writer.put(static_cast<uint8_t>(type | argument));
+        } else if (argument <= UINT8_MAX) {
+            writer.put(type | 24);
+            writer.put(static_cast<uint8_t>(argument));
+        } else if (argument <= UINT16_MAX) {
+            writer.put(type | 25);
+            writer.put_big_endian(static_cast<uint16_t>(argument));
+        } else if (argument <= UINT32_MAX) {
+            writer.put(type | 26);
+            writer.put_big_endian(static_cast<uint32_t>(argument));
+        } else {
+            writer.put(type | 27);
+            writer.put_big_endian(argument);
+        }
+    }
+};
+
+class msgpack_encoder {
+   public:
+    explicit msgpack_encoder(byte_writer& writer) : writer(writer) {}
+
+    void scalar(const json& value) {
+        json::Type type = value.get_type();
+        if (type == json::Type::_null) {
+            writer.put(0xC0);
+        } else if (type == json::Type::_bool) {
+            writer.put(value.as_bool() ? 0xC3 : 0xC2);
+        } else if (type == json::Type::_int) {
+            integer(value.as_int());
+        } else if (type == json::Type::_float) {
+            _float number = value.as_float();
+            if (fits_float(number)) {
+                writer.put(0xCA);
+                writer.put_big_endian(float_bits(static_cast<float>(number)));
+            } else {
+                writer.put(0xCB);
+                writer.put_big_endian(double_bits(number));
+            }
+        } else {
+            string(value.get_string_view());
+        }
+    }
+    void string(std::string_view str) {
+        size_t size = str.size();
+        if (size < 32) {
+            writer.put(static_cast<uint8_t>(0xA0 | size));
+        } else if (size <= UINT8_MAX) {
+            writer.put(0xD9);
+            writer.put(static_cast<uint8_t>(size));
+        } else if (size <= UINT16_MAX) {
+            writer.put(0xDA);
+            writer.put_big_endian(static_cast<uint16_t>(size));
+        } else {
+            writer.put(0xDB);
+            writer.put_big_endian(static_cast<uint32_t>(size));
+        }
+        writer.append(str);
+    }
+    void begin_array(size_t size) { container(size, 0x90, 0xDC); }
+    void begin_object(size_t size) { container(size, 0x80, 0xDE); }
+
+   private:
+    byte_writer& writer;
+
+    // the smallest of the fixint, int and uint forms
+    void integer(_int number) {
+        if (number >= -32 && number < 128) {
+            writer.put(static_cast<uint8_t>(number));
+        } else if (number >= 0) {
+            uint64_t value = static_cast<uint64_t>(number);
+            if (value <= UINT8_MAX) {
+                writer.put(0xCC);
+                writer.put(static_cast<uint8_t>(value));
+            } else if (value <= UINT16_MAX) {
+                writer.put(0xCD);
+                writer.put_big_endian(static_cast<uint16_t>(value));
+            } else if (value <= UINT32_MAX) {
+                writer.put(0xCE);
+                writer.put_big_endian(static_cast<uint32_t>(value));
+            } else {
+                writer.put(0xCF);
+                writer.put_big_endian(value);
+            }
+        } else if (number >= INT8_MIN) {
+            writer.put(0xD0);
+            writer.put(static_cast<uint8_t>(number));
+        } else if (number >= INT16_MIN) {
+            writer.put(0xD1);
+            writer.put_big_endian(static_cast<uint16_t>(number));
+        } else if (number >= INT32_MIN) {
+            writer.put(0xD2);
+            writer.put_big_endian(static_cast<uint32_t>(number));
+        } else {
+            writer.put(0xD3);
+            writer.put_big_endian(static_cast<uint64_t>(number));
+        }
+    }
+
+    // fix form below 16 elements, then 16 and 32-bit sizes
+    void container(size_t size, uint8_t fix, uint8_t sized16) {
+        if (size < 16) {
+            writer.put(static_cast<uint8_t>(fix | size));
+        } else if (size <= UINT16_MAX) {
+            writer.put(sized16);
+            writer.put_big_endian(static_cast<uint16_t>(size));
+        } else {
+            writer.put(sized16 + 1);
+            writer.put_big_endian(static_cast<uint32_t>(size));
+        }
+    }
+};
+
+// walk the tree with an explicit stack like dump_value(), the encoder
+// writes the headers and scalars
+template <class Encoder>
+void encode_binary(const json& root, byte_writer& writer) {
+    Encoder encoder(writer);
+    std::vector<dump_frame> stack;
+    const json* next = &root;
+    while (true) {
+        // descend to the first leaf of next
+        while (true) {
+            json::Type type = next->get_type();
+            if (type == json::Type::_array) {
+                const _array& arr = next->as_array();
+                encoder.begin_array(arr.size());
+                if (arr.empty()) {
+                    break;
+                }
+                stack.push_back({next, 0, _object::const_iterator()});
+                next = &arr[0];
+            } else if (type == json::Type::_object) {
+                const _object& obj = next->as_object();
+                encoder.begin_object(obj.size());
+                if (obj.empty()) {
+                    break;
+                }
+                auto it = obj.begin();
+                encoder.string(it->first);
+                stack.push_back({next, 0, it});
+                next = &it->second;
+            } else {
+                encoder.scalar(*next);
+                break;
+            }
+        }
+        // go on with the next sibling of the containers that end here
+        while (true) {
+            if (stack.empty()) {
+                return;
+            }
+            writer.flush_if_full();
+            dump_frame& top = stack.back();
+            if (top.container->get_type() == json::Type::_array) {
+                const _array& arr = top.container->as_array();
+                if (++top.index < arr.size()) {
+                    next = &arr[top.index];
+                    break;
+                }
+            } else {
+                const _object& obj = top.container->as_object();
+                if (++top.member != obj.end()) {
+                    encoder.string(top.member->first);
+                    next = &top.member->second;
+                    break;
+                }
+            }
+            stack.pop_back();
+        }
+    }
+}
+
+// one decoded item: a scalar, a string or the header of a container
+struct binary_item {
+    enum class kind { scalar, string, array, object };
+
+    kind type = kind::scalar;
+    json value;             // scalar
+    std::string_view text;  // string, points into the input
+    uint64_t size = 0;      // elements or members of a container
+};
+
+// bounds-checked reads from the input
+struct byte_reader {
+    const uint8_t* data;
+    size_t size;
+    size_t index = 0;
+
+    size_t remaining() const { return size - index; }
+
+    template <class T>
+    bool get_big_endian(T& value) {
+        if (remaining() < sizeof(T)) {
+            return false;
+        }
+        value = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            value = static_cast<T>((value << 8) | data[index + i]);
+        }
+        index += sizeof(T);
+        return true;
+    }
+
+    bool get_bytes(uint64_t count, std::string_view& bytes) {
+        if (remaining() < count) {
+            return false;
+        }
+        bytes = std::string_view(reinterpret_cast<const char*>(data + index),
+                                 static_cast<size_t>(count));
+        index += static_cast<size_t>(count);
+        return true;
+    }
+};
+
+float float_from_bits(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+double double_from_bits(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// json integer, or a double if it does not fit
+json integer_value(uint64_t magnitude, bool negative) {
+    if (!negative && magnitude <= uint64_t(INT64_MAX)) {
+        return json(static_cast<_int>(magnitude));
+    } else if (negative && magnitude <= uint64_t(INT64_MAX)) {
+        // -1 - magnitude
+        return json(-static_cast<_int>(magnitude) - 1);
+    } else if (negative) {
+        return json(-1.0 - static_cast<_float>(magnitude));
+    }
+    return json(static_cast<_float>(magnitude));
+}
+
+class cbor_decoder {
+   public:
+    explicit cbor_decoder(byte_reader& input) : input(input) {}
+
+    parse_error next(binary_item& item) {
+        uint8_t initial;
+        // tags only annotate the item that follows
+        do {
+            if (!input.get_big_endian(initial)) {
+                return parse_error::unexpected_end;
+            }
+        } while ((initial >> 5) == 6 && skip_argument(initial));
+        uint8_t major = initial >> 5;
+        uint8_t info = initial & 0x1F;
+        if (major == 7) {
+            return simple(info, item);
+        }
+        uint64_t argument;
+        parse_error error = read_argument(info, argument);
+        if (error != parse_error::none) {
+            return error;
+        }
+        if (major == 0 || major == 1) {
+            item.type = binary_item::kind::scalar;
+            item.value = integer_value(argument, major == 1);
+        } else if (major == 3) {
+            item.type = binary_item::kind::string;
+            if (!input.get_bytes(argument, item.text)) {
+                return parse_error::unexpected_end;
+            }
+        } else if (major == 4 || major == 5) {
+            item.type = major == 4 ? binary_item::kind::array
+                                   : binary_item::kind::object;
+            item.size = argument;
+        } else {
+            // byte strings
+            return parse_error::invalid_value;
+        }
+        return parse_error::none;
+    }
+
+   private:
+    byte_reader& input;
+
+    // reads the argument of a tag, false if it is cut off
+    bool skip_argument(uint8_t initial) {
+        uint64_t argument;
+        return read_argument(initial & 0x1F, argument) == parse_error::none;
+    }
+
+    parse_error read_argument(uint8_t info, uint64_t& argument) {
+        bool complete = true;
+        if (info < 24) {
+            argument = info;
+        } else if (info == 24) {
+            uint8_t value = 0;
+            complete = input.get_big_endian(value);
+            argument = value;
+        } else if (info == 25) {
+            uint16_t value = 0;
+            complete = input.get_big_endian(value);
+            argument = value;
+        } else if (info == 26) {
+            uint32_t value = 0;
+            complete = input.get_big_endian(value);
+            argument = value;
+        } else if (info == 27) {
+            complete = input.get_big_endian(argument);
+        } else {
+            // reserved, or an indefinite length
+            return parse_error::invalid_value;
+        }
+        return complete ? parse_error::none : parse_error::unexpected_end;
+    }
+
+    parse_error simple(uint8_t info, binary_item& item) {
+        item.type = binary_item::kind::scalar;
+        if (info == 20 || info == 21) {
+            item.value = json(info == 21);
+        } else if (info == 22 || info == 23) {
+            // undefined has no json counterpart
+            item.value = json();
+        } else if (info == 25) {
+            uint16_t bits;
+            if (!input.get_big_endian(bits)) {
+                return parse_error::unexpected_end;
+            }
+            item.value = json(half_to_double(bits));
+        } else if (info == 26) {
+            uint32_t bits;
+            if (!input.get_big_endian(bits)) {
+                return parse_error::unexpected_end;
+            }
+            item.value = json(static_cast<_float>(float_from_bits(bits)));
+        } else if (info == 27) {
+            uint64_t bits;
+            if (!input.get_big_endian(bits)) {
+                return parse_error::unexpected_end;
+            }
+            item.value = json(double_from_bits(bits));
+        } else {
+            return parse_error::invalid_value;
+        }
+        return parse_error::none;
+    }
+
+    static double half_to_double(uint16_t bits) {
+        int exponent = (bits >> 10) & 0x1F;
+        double mantissa = bits & 0x3FF;
+        double value;
+        if (exponent == 0) {
+            value = std::ldexp(mantissa, -24);
+        } else if (exponent != 31) {
+            value = std::ldexp(mantissa + 1024, exponent - 25);
+        } else {
+            value = mantissa == 0 ? HUGE_VAL : NAN;
+        }
+        return (bits & 0x8000) ? -value : value;
+    }
+};
+
+class msgpack_decoder {
+   public:
+    explicit msgpack_decoder(byte_reader& input) : input(input) {}
+
+    parse_error next(binary_item& item) {
+        uint8_t type;
+        if (!input.get_big_endian(type)) {
+            return parse_error::unexpected_end;
+        }
+        item.type = binary_item::kind::scalar;
+        if (type <= 0x7F || type >= 0xE0) {
+            // positive and negative fixint, the byte is the value
+            item.value = json(static_cast<_int>(static_cast<int8_t>(type)));
+            return parse_error::none;
+        } else if (type <= 0x8F) {
+            return container(binary_item::kind::object, type & 0x0F, item);
+        } else if (type <= 0x9F) {
+            return container(binary_item::kind::array, type & 0x0F, item);
+        } else if (type <= 0xBF) {
+            return string(type & 0x1F, item);
+        }
+        switch (type) {
+            case 0xC0: item.value = json(); return parse_error::none;
+            case 0xC2: item.value = json(false); return parse_error::none;
+            case 0xC3: item.value = json(true); return parse_error::none;
+            case 0xCA: {
+                uint32_t bits;
+                return scalar(bits, [&] {
+                    return json(static_cast<_float>(float_from_bits(bits)));
+                }, item);
+            }
+            case 0xCB: {
+                uint64_t bits;
+                return scalar(bits, [&] {
+                    return json(double_from_bits(bits));
+                }, item);
+            }
+            case 0xCC: return unsigned_integer<uint8_t>(item);
+            case 0xCD: return unsigned_integer<uint16_t>(item);
+            case 0xCE: return unsigned_integer<uint32_t>(item);
+            case 0xCF: return unsigned_integer<uint64_t>(item);
+            case 0xD0: return signed_integer<uint8_t, int8_t>(item);
+            case 0xD1: return signed_integer<uint16_t, int16_t>(item);
+            case 0xD2: return signed_integer<uint32_t, int32_t>(item);
+            case 0xD3: return signed_integer<uint64_t, int64_t>(item);
+            case 0xD9: return sized<uint8_t>(binary_item::kind::string, item);
+            case 0xDA: return sized<uint16_t>(binary_item::kind::string, item);
+            case 0xDB: return sized<uint32_t>(binary_item::kind::string, item);
+            case 0xDC: return sized<uint16_t>(binary_item::kind::array, item);
+            case 0xDD: return sized<uint32_t>(binary_item::kind::array, item);
+            case 0xDE: return sized<uint16_t>(binary_item::kind::object, item);
+            case 0xDF: return sized<uint32_t>(binary_item::kind::object, item);
+            default:
+                // bin and ext types, and the unused 0xC1
+                return parse_error::invalid_value;
+        }
+    }
+
+   private:
+    byte_reader& input;
+
+    template <class Bits, class Make>
+    parse_error scalar(Bits& bits, Make make, binary_item& item) {
+        if (!input.get_big_endian(bits)) {
+            return parse_error::unexpected_end;
+        }
+        item.value = make();
+        return parse_error::none;
+    }
+
+    template <class T>
+    parse_error unsigned_integer(binary_item& item) {
+        T value;
+        return scalar(value, [&] { return integer_value(value, false); },
+                      item);
+    }
+
+    template <class Bits, class T>
+    parse_error signed_integer(binary_item& item) {
+        Bits bits;
+        return scalar(bits, [&] {
+            return json(static_cast<_int>(static_cast<T>(bits)));
+        }, item);
+    }
+
+    parse_error string(uint64_t size, binary_item& item) {
+        item.type = binary_item::kind::string;
+        return input.get_bytes(size, item.text) ? parse_error::none
+                                                : parse_error::unexpected_end;
+    }
+
+    parse_error container(binary_item::kind type, uint64_t size,
+                          binary_item& item) {
+        item.type = type;
+        item.size = size;
+        return parse_error::none;
+    }
+
+    // a string or container with a Size-byte length
+    template <class Size>
+    parse_error sized(binary_item::kind type, binary_item& item) {
+        Size size;
+        if (!input.get_big_endian(size)) {
+            return parse_error::unexpected_end;
+        }
+        if (type == binary_item::kind::string) {
+            return string(size, item);
+        }
+        return container(type, size, item);
+    }
+};
+
+// builds the tree from the items of Decoder with an explicit stack of
+// open containers, which are sized from their headers
+template <class Decoder>
+class binary_parser {
+   public:
+    binary_parser(const uint8_t* data, size_t size,
+                  const parse_options& options)
+        : input{data, size}, decoder(input), options(options) {}
+
+    parse_error parse(json& out) {
+        json* target = &out;
+        while (true) {
+            parse_error error = parse_value(*target);
+            if (error != parse_error::none) {
+                return error;
+            }
+            // the next element or member, once the open containers that
+            // are complete are closed
+            while (true) {
+                if (stack.empty()) {
+                    if (input.remaining() != 0) {
+                        offset = input.index;
+                        return parse_error::trailing_characters;
+                    }
+                    return parse_error::none;
+                }
+                frame& top = stack.back();
+                if (top.remaining == 0) {
+                    stack.pop_back();
+                    continue;
+                }
+                top.remaining--;
+                if (top.container->get_type() == json::Type::_array) {
+                    target = &top.container->as_array().emplace_back();
+                } else {
+                    error = parse_key(target);
+                    if (error != parse_error::none) {
+                        return error;
+                    }
+                }
+                break;
+            }
+        }
+    }
+
+    // start of the item that failed
+    size_t error_offset() const { return offset; }
+
+   private:
+    struct frame {
+        json* container;
+        uint64_t remaining;  // elements or members still to come
+    };
+
+    byte_reader input;
+    Decoder decoder;
+    const parse_options& options;
+    std::vector<frame> stack;
+    binary_item item;
+    size_t offset = 0;
+
+    parse_error next() {
+        offset = input.index;
+        return decoder.next(item);
+    }
+
+    parse_error parse_value(json& out) {
+        parse_error error = next();
+        if (error != parse_error::none) {
+            return error;
+        }
+        if (item.type == binary_item::kind::scalar) {
+            out = std::move(item.value);
+        } else if (item.type == binary_item::kind::string) {
+            if (options.zero_copy_strings) {
+                out = json::make_view(item.text);
+            } else {
+                out = json(_string(item.text, options.memory()));
+            }
+        } else {
+            if (stack.size() >= options.max_depth) {
+                return parse_error::too_deep;
+            }
+            // every element takes at least one byte, so a corrupt size
+            // cannot reserve more than the input could hold
+            bool is_array = item.type == binary_item::kind::array;
+            if (item.size > input.remaining() / (is_array ? 1 : 2)) {
+                return parse_error::unexpected_end;
+            }
+            if (is_array) {
+                _array arr(options.memory());
+                arr.reserve(static_cast<size_t>(item.size));
+                out = json(std::move(arr));
+            } else {
+                out = json(_object(options.memory()));
+            }
+            if (item.size != 0) {
+                stack.push_back({&out, item.size});
+            }
+        }
+        return parse_error::none;
+    }
+
+    parse_error parse_key(json*& target) {
+        parse_error error = next();
+        if (error != parse_error::none) {
+            return error;
+        }
+        if (item.type != binary_item::kind::string) {
+            return parse_error::expected_key;
+        }
+        target = &member_slot(stack.back().container->as_object(), item.text,
+                              options.keys);
+        return parse_error::none;
+    }
+};
+
+template <class Decoder>
+parse_result parse_binary(const uint8_t* data, size_t size, json& out,
+                          const parse_options& options) {
+    binary_parser<Decoder> parser(data, size, options);
+    parse_error error = parser.parse(out);
+    parse_result result;
+    if (error != parse_error::none) {
+        // binary input has no lines
+        result.error = error;
+        result.offset = parser.error_offset();
+        result.column = result.offset + 1;
+    }
+    return result;
+}
+
+}  // namespace detail
+
+std::vector<uint8_t> to_cbor(const json& value) {
+    std::vector<uint8_t> result;
+    detail::byte_writer writer{result, nullptr};
+    detail::encode_binary<detail::cbor_encoder>(value, writer);
+    return result;
+}
+
+void to_cbor(const json& value, output_sink& sink) {
+    std::vector<uint8_t> buffer;
+    buffer.reserve(detail::byte_writer::chunk_size * 2);
+    detail::byte_writer writer{buffer, &sink};
+    detail::encode_binary<detail::cbor_encoder>(value, writer);
+    if (!buffer.empty()) {
+        writer.flush();
+    }
+}
+
+// decode one CBOR item that spans the whole input, without throwing
+parse_result from_cbor(const uint8_t* data, size_t size, json& out,
+                       const parse_options& options = parse_options()) {
+    return detail::parse_binary<detail::cbor_decoder>(data, size, out,
+                                                      options);
+}
+
+// throws on errors
+json from_cbor(const std::vector<uint8_t>& data,
+               const parse_options& options = parse_options()) {
+    json result;
+    parse_result status = from_cbor(data.data(), data.size(), result, options);
+    if (!status) {
+        MYJSON_THROW(std::runtime_error(
+            "At from_cbor(): " + std::string(status.message()) +
+            " at byte " + std::to_string(status.offset)));
+    }
+    return result;
+}
+
+std::vector<uint8_t> to_msgpack(const json& value) {
+    std::vector<uint8_t> result;
+    detail::byte_writer writer{result, nullptr};
+    detail::encode_binary<detail::msgpack_encoder>(value, writer);
+    return result;
+}
+
+void to_msgpack(const json& value, output_sink& sink) {
+    std::vector<uint8_t> buffer;
+    buffer.reserve(detail::byte_writer::chunk_size * 2);
+    detail::byte_writer writer{buffer, &sink};
+    detail::encode_binary<detail::msgpack_encoder>(value, writer);
+    if (!buffer.empty()) {
+        writer.flush();
+    }
+}
+
+// decode one MessagePack value that spans the whole input, without throwing
+parse_result from_msgpack(const uint8_t* data, size_t size, json& out,
+                          const parse_options& options = parse_options()) {
+    return detail::parse_binary<detail::msgpack_decoder>(data, size, out,
+                                                         options);
+}
+
+// throws on errors
+json from_msgpack(const std::vector<uint8_t>& data,
+                  const parse_options& options = parse_options()) {
+    json result;
+    parse_result status =
+        from_msgpack(data.data(), data.size(), result, options);
+    if (!status) {
+        MYJSON_THROW(std::runtime_error(
+            "At from_msgpack(): " + std::string(status.message()) +
+            " at byte " + std::to_string(status.offset)));
+    }
+    return result;
+}
 
 // Initialization Interface
 json make_json(const std::string& str) { return parse(str); }
@@ -686,4 +7263,4 @@ json make_json(const char* str) { return parse(str); }
 
 json json_init() { return json(myjson::_object()); }
 
-}  // namespace myjson
\ No newline at end of file
+}  // namespace myjson
@@ -0,0 +1,672 @@
+#include "myjson.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Benchmarks for parse, dump, lookup and conversion
+//
+//   g++ -std=c++17 -O2 -pthread myjson_bench.cpp -o myjson_bench
+//   ./myjson_bench [--min-time seconds] [--filter text] [--] [file ...]
+//
+// Without files, generated documents shaped like the standard corpora are
+// used: twitter.json (records of short strings and nested objects),
+// citm_catalog.json (deep objects of integers), canada.json (arrays of
+// coordinates) and an NDJSON log. Files named *.ndjson are parsed line by
+// line, any other file as one document. The results are printed to stdout
+// as a json array, one object per benchmark, progress goes to stderr.
+
+// Allocation counting
+// every operator new is counted, allocations_per_op is the difference over
+// a benchmark's iterations
+static std::atomic<size_t> allocation_count{0};
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+// std::pmr::new_delete_resource() allocates with an explicit alignment,
+// the block before the aligned pointer keeps the one from malloc
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    size_t align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+    void* raw = std::malloc(size + align);
+    if (raw == nullptr) {
+        throw std::bad_alloc();
+    }
+    uintptr_t aligned =
+        (reinterpret_cast<uintptr_t>(raw) + align) & ~(uintptr_t(align) - 1);
+    reinterpret_cast<void**>(aligned)[-1] = raw;
+    return reinterpret_cast<void*>(aligned);
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+void operator delete(void* p, std::align_val_t) noexcept {
+    if (p != nullptr) {
+        std::free(static_cast<void**>(p)[-1]);
+    }
+}
+void operator delete[](void* p, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+
+// Harness
+struct benchmark_result {
+    std::string name;
+    size_t iterations;
+    double ns_per_op;
+    size_t bytes_per_op;      // input or output size, 0 if not meaningful
+    size_t items_per_op;      // lookups or conversions done by one op
+    double allocations_per_op;
+};
+
+struct harness {
+    double min_time = 0.5;  // seconds per benchmark
+    std::string filter;     // run only names containing it
+    std::vector<benchmark_result> results;
+    volatile size_t sink = 0;  // keeps the work from being optimized away
+
+    // op returns a value derived from its work
+    template <class Op>
+    void run(const std::string& name, size_t bytes, size_t items, Op op) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            return;
+        }
+        using clock = std::chrono::steady_clock;
+        sink = sink + op();  // warm up
+        size_t iterations = 0;
+        size_t allocations = allocation_count.load();
+        clock::time_point start = clock::now();
+        double elapsed = 0;
+        do {
+            sink = sink + op();
+            iterations++;
+            elapsed = std::chrono::duration<double>(clock::now() - start)
+                          .count();
+        } while (elapsed < min_time);
+        allocations = allocation_count.load() - allocations;
+        benchmark_result result{name,
+                                iterations,
+                                elapsed * 1e9 / iterations,
+                                bytes,
+                                items,
+                                double(allocations) / iterations};
+        std::cerr << name << ": " << result.ns_per_op / 1e3 << " us/op, "
+                  << result.allocations_per_op << " allocations/op\n";
+        results.push_back(result);
+    }
+
+    std::string report() const {
+        myjson::json out = myjson::json(myjson::_array());
+        for (const benchmark_result& result : results) {
+            myjson::json entry = myjson::json_init();
+            entry["name"] = result.name;
+            entry["iterations"] = static_cast<int64_t>(result.iterations);
+            entry["ns_per_op"] = result.ns_per_op;
+            if (result.bytes_per_op > 0) {
+                entry["bytes_per_op"] =
+                    static_cast<int64_t>(result.bytes_per_op);
+                entry["mb_per_s"] =
+                    result.bytes_per_op * 1e3 / result.ns_per_op;
+            }
+            if (result.items_per_op > 0) {
+                entry["items_per_op"] =
+                    static_cast<int64_t>(result.items_per_op);
+                entry["ns_per_item"] = result.ns_per_op / result.items_per_op;
+            }
+            entry["allocations_per_op"] = result.allocations_per_op;
+            out.push(std::move(entry));
+        }
+        return out.dump();
+    }
+};
+
+// Generated corpora
+// fixed seeds, so every run measures the same documents
+std::string random_word(std::mt19937_64& rng, size_t min, size_t max) {
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyz";
+    size_t size = min + rng() % (max - min + 1);
+    std::string word;
+    for (size_t i = 0; i < size; i++) {
+        word += letters[rng() % 26];
+    }
+    return word;
+}
+
+std::string random_text(std::mt19937_64& rng, size_t words) {
+    std::string text;
+    for (size_t i = 0; i < words; i++) {
+        if (i > 0) {
+            text += ' ';
+        }
+        text += random_word(rng, 2, 9);
+        // some tweets have non-ASCII text and line breaks
+        if (rng() % 16 == 0) {
+            text += "\xc3\xa9\xe2\x80\x99";
+        } else if (rng() % 32 == 0) {
+            text += '\n';
+        }
+    }
+    return text;
+}
+
+std::string make_twitter() {
+    std::mt19937_64 rng(1);
+    myjson::json statuses = myjson::json(myjson::_array());
+    for (int i = 0; i < 1000; i++) {
+        myjson::json user = myjson::json_init();
+        user["id"] = static_cast<int64_t>(rng() % 4000000000u);
+        user["name"] = random_word(rng, 4, 12);
+        user["screen_name"] = random_word(rng, 4, 15);
+        user["location"] = random_text(rng, 2);
+        user["description"] = random_text(rng, 12);
+        user["url"] = myjson::json();
+        user["followers_count"] = static_cast<int64_t>(rng() % 100000);
+        user["friends_count"] = static_cast<int64_t>(rng() % 5000);
+        user["verified"] = rng() % 10 == 0;
+        user["lang"] = "ja";
+        myjson::json hashtags = myjson::json(myjson::_array());
+        for (size_t h = rng() % 3; h > 0; h--) {
+            myjson::json tag = myjson::json_init();
+            tag["text"] = random_word(rng, 3, 10);
+            myjson::json indices = myjson::json(myjson::_array());
+            indices.push(static_cast<int64_t>(rng() % 100));
+            indices.push(static_cast<int64_t>(rng() % 100 + 100));
+            tag["indices"] = std::move(indices);
+            hashtags.push(std::move(tag));
+        }
+        myjson::json entities = myjson::json_init();
+        entities["hashtags"] = std::move(hashtags);
+        entities["urls"] = myjson::json(myjson::_array());
+        myjson::json status = myjson::json_init();
+        status["created_at"] = "Sun Aug 31 00:29:15 +0000 2014";
+        status["id"] = static_cast<int64_t>(505874924095815680 + i);
+        status["id_str"] = std::to_string(505874924095815680 + i);
+        status["text"] = random_text(rng, 14);
+        status["source"] = "<a href=\"http://twitter.com\">Twitter</a>";
+        status["truncated"] = false;
+        status["in_reply_to_status_id"] = myjson::json();
+        status["user"] = std::move(user);
+        status["geo"] = myjson::json();
+        status["coordinates"] = myjson::json();
+        status["retweet_count"] = static_cast<int64_t>(rng() % 1000);
+        status["favorite_count"] = static_cast<int64_t>(rng() % 1000);
+        status["entities"] = std::move(entities);
+        status["favorited"] = false;
+        status["retweeted"] = false;
+        statuses.push(std::move(status));
+    }
+    myjson::json metadata = myjson::json_init();
+    metadata["completed_in"] = 0.087;
+    metadata["max_id"] = static_cast<int64_t>(505874924095815681);
+    metadata["count"] = 1000;
+    myjson::json root = myjson::json_init();
+    root["statuses"] = std::move(statuses);
+    root["search_metadata"] = std::move(metadata);
+    return root.dump();
+}
+
+std::string make_citm_catalog() {
+    std::mt19937_64 rng(2);
+    myjson::json area_names = myjson::json_init();
+    for (int64_t i = 0; i < 20; i++) {
+        area_names[std::to_string(205705993 + i)] = random_text(rng, 3);
+    }
+    myjson::json events = myjson::json_init();
+    for (int64_t i = 0; i < 200; i++) {
+        myjson::json event = myjson::json_init();
+        event["description"] = myjson::json();
+        event["id"] = 138586341 + i;
+        event["logo"] = myjson::json();
+        event["name"] = random_text(rng, 4);
+        myjson::json topics = myjson::json(myjson::_array());
+        for (int t = 0; t < 4; t++) {
+            topics.push(static_cast<int64_t>(337184262 + rng() % 100));
+        }
+        event["subTopicIds"] = topics;
+        event["topicIds"] = std::move(topics);
+        events[std::to_string(138586341 + i)] = std::move(event);
+    }
+    myjson::json performances = myjson::json(myjson::_array());
+    for (int64_t i = 0; i < 2000; i++) {
+        myjson::json prices = myjson::json(myjson::_array());
+        myjson::json categories = myjson::json(myjson::_array());
+        for (int64_t c = 0; c < 3; c++) {
+            myjson::json price = myjson::json_init();
+            price["amount"] = static_cast<int64_t>(rng() % 200 + 10) * 1000;
+            price["audienceSubCategoryId"] = 337100890;
+            price["seatCategoryId"] = 338937295 + c;
+            prices.push(std::move(price));
+            myjson::json areas = myjson::json(myjson::_array());
+            for (int64_t a = 0; a < 4; a++) {
+                myjson::json area = myjson::json_init();
+                area["areaId"] = 205705993 + a;
+                area["blockIds"] = myjson::json(myjson::_array());
+                areas.push(std::move(area));
+            }
+            myjson::json category = myjson::json_init();
+            category["areas"] = std::move(areas);
+            category["seatCategoryId"] = 338937295 + c;
+            categories.push(std::move(category));
+        }
+        myjson::json performance = myjson::json_init();
+        performance["eventId"] = 138586341 + i % 200;
+        performance["id"] = 339887544 + i;
+        performance["logo"] = myjson::json();
+        performance["name"] = myjson::json();
+        performance["prices"] = std::move(prices);
+        performance["seatCategories"] = std::move(categories);
+        performance["seatMapImage"] = myjson::json();
+        performance["start"] = 1372701600000 + i * 86400000;
+        performance["venueCode"] = "PLEYEL_PLEYEL";
+        performances.push(std::move(performance));
+    }
+    myjson::json root = myjson::json_init();
+    root["areaNames"] = std::move(area_names);
+    root["events"] = std::move(events);
+    root["performances"] = std::move(performances);
+    return root.dump();
+}
+
+std::string make_canada() {
+    std::mt19937_64 rng(3);
+    std::uniform_real_distribution<double> step(-0.01, 0.01);
+    myjson::json polygons = myjson::json(myjson::_array());
+    for (int p = 0; p < 100; p++) {
+        myjson::json ring = myjson::json(myjson::_array());
+        double x = -65.613616999999977;
+        double y = 43.420273000000009;
+        for (int i = 0; i < 1000; i++) {
+            x += step(rng);
+            y += step(rng);
+            myjson::json point = myjson::json(myjson::_array());
+            point.push(x);
+            point.push(y);
+            ring.push(std::move(point));
+        }
+        polygons.push(std::move(ring));
+    }
+    myjson::json geometry = myjson::json_init();
+    geometry["type"] = "Polygon";
+    geometry["coordinates"] = std::move(polygons);
+    myjson::json properties = myjson::json_init();
+    properties["name"] = "Canada";
+    myjson::json feature = myjson::json_init();
+    feature["type"] = "Feature";
+    feature["properties"] = std::move(properties);
+    feature["geometry"] = std::move(geometry);
+    myjson::json features = myjson::json(myjson::_array());
+    features.push(std::move(feature));
+    myjson::json root = myjson::json_init();
+    root["type"] = "FeatureCollection";
+    root["features"] = std::move(features);
+    return root.dump();
+}
+
+std::string make_ndjson_log() {
+    std::mt19937_64 rng(4);
+    static const char* levels[] = {"debug", "info", "warn", "error"};
+    std::string log;
+    for (int i = 0; i < 20000; i++) {
+        myjson::json record = myjson::json_init();
+        record["ts"] = "2024-05-01T12:00:00." + std::to_string(i % 1000) + "Z";
+        record["level"] = levels[rng() % 4];
+        record["service"] = "api-" + random_word(rng, 3, 6);
+        record["path"] = "/v1/" + random_word(rng, 4, 10) + "/" +
+                         std::to_string(rng() % 100000);
+        record["status"] = static_cast<int64_t>(rng() % 2 ? 200 : 404);
+        record["latency_ms"] = static_cast<double>(rng() % 100000) / 100;
+        record["user"] = static_cast<int64_t>(rng() % 1000000);
+        log += record.dump(myjson::dump_options{true});
+        log += '\n';
+    }
+    return log;
+}
+
+// Parse and dump
+size_t top_level_size(const myjson::json& value) {
+    if (value.get_type() == myjson::json::Type::_array) {
+        return value.as_array().size();
+    } else if (value.get_type() == myjson::json::Type::_object) {
+        return value.as_object().size();
+    }
+    return 1;
+}
+
+size_t count_records(std::string_view log) {
+    size_t records = 0;
+    myjson::parse_ndjson(log, [&](myjson::json&) { records++; });
+    return records;
+}
+
+void bench_document(harness& h, const std::string& name,
+                    const std::string& text) {
+    h.run("parse/" + name, text.size(), 0,
+          [&] { return top_level_size(myjson::parse(text)); });
+    myjson::parse_options indexed;
+    indexed.use_structural_index = true;
+    h.run("parse_structural/" + name, text.size(), 0,
+          [&] { return top_level_size(myjson::parse(text, indexed)); });
+    myjson::arena memory;
+    myjson::parse_options views;
+    views.zero_copy_strings = true;
+    h.run("parse_arena/" + name, text.size(), 0, [&] {
+        size_t size = top_level_size(myjson::parse(text, memory, views));
+        memory.release();
+        return size;
+    });
+    myjson::parser reused;
+    h.run("parser_reuse/" + name, text.size(), 0, [&] {
+        reused.parse(text);
+        return top_level_size(reused.root());
+    });
+    h.run("lazy_index/" + name, text.size(), 0, [&] {
+        myjson::lazy_document document(text);
+        return static_cast<size_t>(document.root().get_type());
+    });
+    myjson::json value = myjson::parse(text);
+    std::string output = value.dump();
+    h.run("dump/" + name, output.size(), 0,
+          [&] { return value.dump().size(); });
+    myjson::dump_options compact{true};
+    std::string compact_output = value.dump(compact);
+    h.run("dump_compact/" + name, compact_output.size(), 0,
+          [&] { return value.dump(compact).size(); });
+}
+
+void bench_ndjson(harness& h, const std::string& name,
+                  const std::string& text) {
+    size_t records = count_records(text);
+    h.run("parse_ndjson/" + name, text.size(), records,
+          [&] { return count_records(text); });
+    myjson::ndjson_options single;
+    single.threads = 1;
+    h.run("parse_ndjson_1thread/" + name, text.size(), records, [&] {
+        size_t count = 0;
+        myjson::parse_ndjson(text, [&](myjson::json&) { count++; }, single);
+        return count;
+    });
+    // one message at a time, as a consumer of a queue sees them
+    std::vector<std::string_view> lines;
+    for (size_t start = 0; start < text.size();) {
+        size_t end = std::min(text.find('\n', start), text.size());
+        lines.push_back(std::string_view(text).substr(start, end - start));
+        start = end + 1;
+    }
+    h.run("parse_messages/" + name, text.size(), lines.size(), [&] {
+        size_t size = 0;
+        for (std::string_view line : lines) {
+            size += top_level_size(myjson::parse(line));
+        }
+        return size;
+    });
+    myjson::parser reused;
+    h.run("parser_messages/" + name, text.size(), lines.size(), [&] {
+        size_t size = 0;
+        for (std::string_view line : lines) {
+            reused.parse(line);
+            size += top_level_size(reused.root());
+        }
+        return size;
+    });
+}
+
+// Lookup
+void bench_lookup(harness& h, size_t keys) {
+    std::mt19937_64 rng(5);
+    myjson::json object = myjson::json_init();
+    std::vector<std::string> names;
+    for (size_t i = 0; i < keys; i++) {
+        names.push_back("key_" + random_word(rng, 4, 12) + std::to_string(i));
+        object[names.back()] = static_cast<int64_t>(i);
+    }
+    std::shuffle(names.begin(), names.end(), rng);
+    // the same number of lookups per op for every object size
+    const size_t lookups = 10000;
+    std::vector<std::string> missing;
+    for (size_t i = 0; i < lookups; i++) {
+        missing.push_back("absent_" + std::to_string(i));
+    }
+    std::string size = std::to_string(keys);
+    const myjson::json& lookup = object;
+    h.run("lookup_hit/" + size + "_keys", 0, lookups, [&] {
+        size_t found = 0;
+        for (size_t i = 0; i < lookups; i++) {
+            found += lookup.find(names[i % names.size()]) != nullptr;
+        }
+        return found;
+    });
+    h.run("lookup_miss/" + size + "_keys", 0, lookups, [&] {
+        size_t found = 0;
+        for (size_t i = 0; i < lookups; i++) {
+            found += lookup.find(missing[i]) != nullptr;
+        }
+        return found;
+    });
+}
+
+void bench_pointer(harness& h, const std::string& twitter) {
+    myjson::json value = myjson::parse(twitter);
+    myjson::json_pointer pointer("/statuses/500/user/screen_name");
+    h.run("lookup_pointer/twitter", 0, 1, [&] {
+        return pointer.find(value)->get_string_view().size();
+    });
+    myjson::lazy_document document(twitter);
+    myjson::lazy_json root = document.root();
+    h.run("lookup_pointer_lazy/twitter", 0, 1, [&] {
+        return pointer.find(root).get<std::string>().size();
+    });
+}
+
+// Conversion
+struct point {
+    double x;
+    double y;
+    std::string label;
+    std::vector<int64_t> tags;
+};
+
+MYJSON_DEFINE(point, x, y, label, tags)
+
+namespace myjson {
+void to_json(json& j, const point& p) {
+    j = json_init();
+    j["x"] = p.x;
+    j["y"] = p.y;
+    j["label"] = p.label;
+    json tags = json(_array());
+    for (int64_t tag : p.tags) {
+        tags.push(tag);
+    }
+    j["tags"] = std::move(tags);
+}
+
+void from_json(const json& j, point& p) {
+    p.x = j["x"].get<double>();
+    p.y = j["y"].get<double>();
+    p.label = j["label"].get<std::string>();
+    p.tags.clear();
+    for (const json& tag : j["tags"].as_array()) {
+        p.tags.push_back(tag.get<int64_t>());
+    }
+}
+}  // namespace myjson
+
+void bench_conversion(harness& h) {
+    const size_t count = 1000;
+    myjson::json ints = myjson::json(myjson::_array());
+    myjson::json floats = myjson::json(myjson::_array());
+    myjson::json strings = myjson::json(myjson::_array());
+    std::vector<point> points;
+    std::mt19937_64 rng(6);
+    for (size_t i = 0; i < count; i++) {
+        ints.push(static_cast<int64_t>(rng()));
+        floats.push(static_cast<double>(rng() % 1000000) / 1000);
+        strings.push(random_text(rng, 3));
+        points.push_back({double(i), double(i) / 2, random_word(rng, 4, 20),
+                          {1, 2, static_cast<int64_t>(i)}});
+    }
+    const size_t elements = 100000;
+    h.run("build_array/push", 0, elements, [&] {
+        myjson::json array = myjson::json(myjson::_array());
+        for (size_t i = 0; i < elements; i++) {
+            array.push(static_cast<int64_t>(i));
+        }
+        return array.as_array().size();
+    });
+    h.run("build_array/reserved", 0, elements, [&] {
+        myjson::json array = myjson::json::array(elements);
+        for (size_t i = 0; i < elements; i++) {
+            array.push(static_cast<int64_t>(i));
+        }
+        return array.as_array().size();
+    });
+    h.run("get_int64", 0, count, [&] {
+        int64_t sum = 0;
+        for (const myjson::json& value : ints.as_array()) {
+            sum += value.get<int64_t>();
+        }
+        return static_cast<size_t>(sum);
+    });
+    h.run("get_double", 0, count, [&] {
+        double sum = 0;
+        for (const myjson::json& value : floats.as_array()) {
+            sum += value.get<double>();
+        }
+        return static_cast<size_t>(sum);
+    });
+    h.run("get_string", 0, count, [&] {
+        size_t size = 0;
+        for (const myjson::json& value : strings.as_array()) {
+            size += value.get<std::string>().size();
+        }
+        return size;
+    });
+    h.run("to_json_from_json/point", 0, count, [&] {
+        size_t size = 0;
+        for (const point& p : points) {
+            myjson::json j;
+            j = p;
+            size += j.get<point>().label.size();
+        }
+        return size;
+    });
+    std::string text = myjson::dump(points);
+    h.run("bound_dump/point", text.size(), count,
+          [&] { return myjson::dump(points).size(); });
+    h.run("bound_parse/point", text.size(), count, [&] {
+        std::vector<point> parsed;
+        myjson::parse_into(text, parsed);
+        return parsed.size();
+    });
+    h.run("tree_parse_get/point", text.size(), count, [&] {
+        std::vector<point> parsed;
+        myjson::json tree = myjson::parse(text);
+        for (const myjson::json& j : tree.as_array()) {
+            parsed.push_back(j.get<point>());
+        }
+        return parsed.size();
+    });
+}
+
+bool read_corpus(const std::string& path, std::string& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    out = buffer.str();
+    return true;
+}
+
+bool ends_with(const std::string& str, const std::string& suffix) {
+    return str.size() >= suffix.size() &&
+           str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+const char* usage =
+    "usage: myjson_bench [--min-time seconds] [--filter text] [--] "
+    "[file ...]\n";
+
+int main(int argc, char** argv) {
+    harness h;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::cout << usage;
+            return 0;
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            h.min_time = std::atof(argv[++i]);
+        } else if (arg == "--filter" && i + 1 < argc) {
+            h.filter = argv[++i];
+        } else if (arg == "--") {
+            // the rest are files, even when they start with '-'
+            while (++i < argc) {
+                files.push_back(argv[i]);
+            }
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::cerr << "unknown or incomplete option " << arg << "\n"
+                      << usage;
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    std::string twitter = make_twitter();
+    if (files.empty()) {
+        bench_document(h, "twitter", twitter);
+        bench_document(h, "citm_catalog", make_citm_catalog());
+        bench_document(h, "canada", make_canada());
+        bench_ndjson(h, "log", make_ndjson_log());
+    }
+    for (const std::string& path : files) {
+        std::string text;
+        if (!read_corpus(path, text)) {
+            std::cerr << "cannot read " << path << "\n";
+            return 1;
+        }
+        std::string name = path.substr(path.find_last_of("/\\") + 1);
+        if (ends_with(path, ".ndjson")) {
+            bench_ndjson(h, name, text);
+        } else {
+            bench_document(h, name, text);
+        }
+    }
+    for (size_t keys : {10, 1000, 100000}) {
+        bench_lookup(h, keys);
+    }
+    bench_pointer(h, twitter);
+    bench_conversion(h);
+
+    std::cout << h.report() << std::endl;
+    return 0;
+}
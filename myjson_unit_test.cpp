@@ -0,0 +1,1255 @@
+#include "myjson.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#if !defined(MYJSON_NO_THREADS)
+#include <thread>
+#endif
+
+// Behavior checks for myjson.h, exits with 1 if any check fails
+//
+//   g++ -std=c++17 -g -pthread -fsanitize=address,undefined
+//       myjson_unit_test.cpp -o myjson_unit_test
+//   ./myjson_unit_test
+//
+// Build it once more with -DMYJSON_FLAT_OBJECT and -DMYJSON_HASH_OBJECT to
+// cover the other object backends, and with -DMYJSON_STATS for the
+// statistics counters.
+
+static int failures = 0;
+static int checks = 0;
+
+#define CHECK(condition)                                                 \
+    do {                                                                 \
+        checks++;                                                        \
+        if (!(condition)) {                                              \
+            failures++;                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #condition \
+                      << " failed\n";                                    \
+        }                                                                \
+    } while (false)
+
+// true if calling f throws std::exception
+template <class F>
+static bool throws(F f) {
+    try {
+        f();
+    } catch (const std::exception&) {
+        return true;
+    }
+    return false;
+}
+
+static myjson::parse_options structural_options() {
+    myjson::parse_options options;
+    options.use_structural_index = true;
+    return options;
+}
+
+// Parse results
+static void test_parse_result() {
+    struct error_case {
+        const char* text;
+        myjson::parse_error error;
+        size_t offset;
+    };
+    const error_case cases[] = {
+        {"[1,2", myjson::parse_error::unexpected_end, 4},
+        {"[1 2]", myjson::parse_error::expected_comma_or_bracket, 3},
+        {"{\"a\" 1}", myjson::parse_error::expected_colon, 5},
+        {"{\"a\":1 \"b\":2}", myjson::parse_error::expected_comma_or_brace, 7},
+        {"{1:2}", myjson::parse_error::expected_key, 1},
+        {"[1,]", myjson::parse_error::invalid_value, 3},
+        {"[nul]", myjson::parse_error::invalid_literal, 1},
+        {"[tru", myjson::parse_error::unexpected_end, 4},
+        {"[-]", myjson::parse_error::invalid_number, 2},
+        {"[1.]", myjson::parse_error::invalid_number, 3},
+        {"[1e+]", myjson::parse_error::invalid_number, 4},
+        {"[\"a\\x\"]", myjson::parse_error::invalid_escape, 3},
+        {"[\"\\u12G4\"]", myjson::parse_error::invalid_escape, 2},
+        {"[\"abc", myjson::parse_error::unexpected_end, 5},
+    };
+    for (const error_case& c : cases) {
+        for (bool structural : {false, true}) {
+            myjson::json out;
+            myjson::parse_options options;
+            options.use_structural_index = structural;
+            myjson::parse_result result = myjson::parse(c.text, out, options);
+            CHECK(!result);
+            CHECK(result.error == c.error);
+            CHECK(result.offset == c.offset);
+        }
+    }
+
+    myjson::json out;
+    myjson::parse_result result = myjson::parse("[1,\n  2,\n  x]", out);
+    CHECK(result.error == myjson::parse_error::invalid_value);
+    CHECK(result.offset == 11);
+    CHECK(result.line == 3);
+    CHECK(result.column == 3);
+    CHECK(std::string(result.message()) == "expected a value");
+
+    // nesting is limited instead of overflowing the stack
+    std::string deep(100000, '[');
+    for (bool structural : {false, true}) {
+        myjson::parse_options shallow;
+        shallow.use_structural_index = structural;
+        shallow.max_depth = 2;
+        CHECK(myjson::parse("[[1]]", out, shallow));
+        result = myjson::parse("[{\"a\":[1]}]", out, shallow);
+        CHECK(result.error == myjson::parse_error::too_deep);
+        CHECK(result.offset == 6);
+        CHECK(myjson::parse(deep, out, shallow).error ==
+              myjson::parse_error::too_deep);
+        myjson::stream_parser stream(shallow);
+        CHECK(stream.feed("[[[1]]]").error == myjson::parse_error::too_deep);
+    }
+    CHECK(myjson::parse(deep, out).error == myjson::parse_error::too_deep);
+    CHECK(throws([&] { myjson::parse(deep); }));
+    // deeper limits may be set, dump uses no call stack per level
+    myjson::parse_options deeper;
+    deeper.max_depth = 5000;
+    std::string nested = std::string(4000, '[') + std::string(4000, ']');
+    CHECK(myjson::parse(nested, out, deeper));
+    myjson::dump_options compact;
+    compact.compact = true;
+    CHECK(out.dump(compact) == nested);
+
+    // only whitespace may follow the value
+    const error_case incomplete[] = {
+        {"", myjson::parse_error::unexpected_end, 0},
+        {" \n", myjson::parse_error::unexpected_end, 2},
+        {"[1] x", myjson::parse_error::trailing_characters, 4},
+        {"1 2", myjson::parse_error::trailing_characters, 2},
+        {"{}}", myjson::parse_error::trailing_characters, 2},
+        {"\"a\"\"b\"", myjson::parse_error::trailing_characters, 3},
+    };
+    for (const error_case& c : incomplete) {
+        for (bool structural : {false, true}) {
+            myjson::parse_options options;
+            options.use_structural_index = structural;
+            myjson::parse_result result = myjson::parse(c.text, out, options);
+            CHECK(result.error == c.error);
+            CHECK(result.offset == c.offset);
+            myjson::parser reused(options);
+            result = reused.parse(c.text);
+            CHECK(result.error == c.error);
+            CHECK(result.offset == c.offset);
+        }
+        myjson::parallel_options parallel;
+        parallel.threads = 2;
+        parallel.chunk_size = 1;
+        CHECK(myjson::parse_parallel(c.text, out, parallel).error == c.error);
+    }
+    // the throwing parse() keeps the lenient behavior of the first versions
+    CHECK(myjson::parse("") == myjson::json());
+    CHECK(myjson::parse("[1] x") == myjson::parse("[1]"));
+
+    CHECK(myjson::parse(" {\"a\": [1, 2.5, \"x\", null, true]} ", out));
+    CHECK(out["a"][1] == myjson::json(2.5));
+    CHECK(throws([] { myjson::parse("[1,"); }));
+}
+
+// Zero-copy strings
+// true if str points into text
+static bool in_buffer(std::string_view str, const std::string& text) {
+    return str.data() >= text.data() &&
+           str.data() + str.size() <= text.data() + text.size();
+}
+
+static void test_zero_copy() {
+    const std::string text =
+        "{\"short\":\"plain\",\"esc\":\"tab\\there\","
+        "\"list\":[\"a string longer than the inline buffer\"]}";
+    const myjson::json copied = myjson::parse(text);
+    for (bool structural : {false, true}) {
+        myjson::parse_options options;
+        options.zero_copy_strings = true;
+        options.use_structural_index = structural;
+        myjson::json value = myjson::parse(text, options);
+        CHECK(value == copied);
+        CHECK(value["short"].get_type() == myjson::json::Type::_string);
+        CHECK(in_buffer(value["short"].get_string_view(), text));
+        CHECK(in_buffer(value["list"][0].get_string_view(), text));
+        // strings with escapes are decoded into a copy
+        CHECK(value["esc"].get_string_view() == "tab\there");
+        CHECK(!in_buffer(value["esc"].get_string_view(), text));
+        // a copy of the tree compares equal and still reads the buffer
+        myjson::json again = value;
+        CHECK(again == copied);
+    }
+    CHECK(!in_buffer(copied["short"].get_string_view(), text));
+
+    // raw buffers need no terminating NUL, only the given bytes are read
+    const char buffer[] = {'[', '1', ',', '"', 'x', '"', ']', '9'};
+    CHECK(myjson::parse(buffer, 7) == myjson::parse("[1,\"x\"]"));
+    myjson::json out;
+    CHECK(myjson::parse(std::string_view(buffer, 7), out));
+    CHECK(!myjson::parse(std::string_view(buffer, 8), out));
+}
+
+// Round trips
+static void test_roundtrip() {
+    const char* documents[] = {
+        "null",
+        "true",
+        "-0",
+        "123456789012345678",
+        "-9223372036854775808",
+        "1.5",
+        "1e300",
+        "0.1",
+        "\"\"",
+        "\"short\"",
+        "\"a string longer than the inline buffer\"",
+        "\"\\u00e9\\ud83d\\ude00\\n\\t\\\"\\\\\"",
+        "[]",
+        "{}",
+        "[[],[[]],{}]",
+        "{\"a\":{\"b\":[1,{\"c\":null}]},\"d\":\"e\"}",
+    };
+    for (const char* text : documents) {
+        myjson::json value = myjson::parse(text);
+        myjson::json again = myjson::parse(value.dump());
+        CHECK(again == value);
+        CHECK(myjson::parse(text, structural_options()) == value);
+        myjson::dump_options compact;
+        compact.compact = true;
+        CHECK(myjson::parse(value.dump(compact)) == value);
+    }
+    CHECK(myjson::parse("1.0").get_type() == myjson::json::Type::_float);
+    CHECK(myjson::parse("1.0").dump() == "1.0");
+    CHECK(myjson::parse("0.1").dump() == "0.1");
+    CHECK(myjson::parse("9223372036854775808").get_type() ==
+          myjson::json::Type::_float);
+    CHECK(myjson::parse("\"\\u20AC\"").get_string_view() == "\xE2\x82\xAC");
+}
+
+// Object backends
+// the same checks for the sorted map and the flat and hash backends, only
+// the order of members differs
+static void test_objects() {
+#if defined(MYJSON_FLAT_OBJECT) || defined(MYJSON_HASH_OBJECT)
+    const bool insertion_order = true;
+#else
+    const bool insertion_order = false;
+#endif
+    myjson::dump_options compact;
+    compact.compact = true;
+
+    myjson::json object = myjson::parse("{}");
+    object["z"] = 1;
+    object["a"] = 2;
+    object["a key longer than inline keys"] = 3;
+    CHECK(object.as_object().size() == 3);
+    CHECK(object["a"].as_int() == 2);
+    CHECK(object.contains("a key longer than inline keys"));
+    CHECK(!object.contains("b"));
+    CHECK(object.find("b") == nullptr);
+    CHECK(object.emplace("z", 5).as_int() == 1);
+    object.remove("a");
+    object.remove("b");
+    CHECK(object.dump(compact) ==
+          (insertion_order ? "{\"z\":1,\"a key longer than inline keys\":3}"
+                           : "{\"a key longer than inline keys\":3,\"z\":1}"));
+
+    // a repeated key keeps the last value
+    myjson::json repeated = myjson::parse("{\"b\":1,\"a\":2,\"b\":3}");
+    CHECK(repeated.dump(compact) ==
+          (insertion_order ? "{\"b\":3,\"a\":2}" : "{\"a\":2,\"b\":3}"));
+    CHECK(repeated == myjson::parse("{\"a\":2,\"b\":3}"));
+    CHECK(repeated != myjson::parse("{\"a\":2,\"b\":4}"));
+    CHECK(repeated != myjson::parse("{\"a\":2}"));
+
+    // enough members for the hash index, erasing rebuilds it
+    myjson::json large = myjson::parse("{}");
+    for (int i = 0; i < 100; i++) {
+        large["key" + std::to_string(i)] = i;
+    }
+    for (int i = 0; i < 100; i += 2) {
+        large.remove("key" + std::to_string(i));
+    }
+    large["key0"] = 0;
+    bool found = large.as_object().size() == 51;
+    for (int i = 1; i < 100; i++) {
+        const myjson::json* member = large.find("key" + std::to_string(i));
+        found = found && (i % 2 == 0 ? member == nullptr
+                                     : member != nullptr &&
+                                           member->as_int() == i);
+    }
+    CHECK(found);
+    CHECK(large.find("key0") != nullptr);
+    CHECK(myjson::parse(large.dump()) == large);
+    if (insertion_order) {
+        CHECK(large.as_object().begin()->first == "key1");
+    }
+
+    // interned keys are found like any other
+    myjson::parse_options interned;
+    interned.intern_keys = true;
+    myjson::document doc;
+    doc.parse("[{\"name\":1,\"a key longer than inline keys\":2},"
+              "{\"name\":3,\"a key longer than inline keys\":4}]",
+              interned);
+    CHECK(doc.root()[1]["name"].as_int() == 3);
+    CHECK(doc.root()[1]["a key longer than inline keys"].as_int() == 4);
+    CHECK(doc.root()[0] != doc.root()[1]);
+    myjson::json copy = doc.root();
+    CHECK(copy == doc.root());
+}
+
+// Stream parser
+// every document split into two chunks at every position, and fed one
+// byte at a time, gives the same tree as parse()
+static void test_stream_parser() {
+    const char* documents[] = {
+        "{\"name\":\"stream\",\"values\":[1,-2.5e3,true,false,null],"
+        "\"nested\":{\"s\":\"esc\\\"aped\\u00e9\",\"e\":[]}}",
+        "[12345678901234567890, 0.000123, \"\\ud83d\\ude00\"]",
+        "  \"top level string\"  ",
+        "-42",
+        "true",
+    };
+    for (const char* text : documents) {
+        std::string str = text;
+        myjson::json expected = myjson::parse(str);
+        for (size_t split = 0; split <= str.size(); split++) {
+            myjson::stream_parser parser;
+            CHECK(parser.feed(str.data(), split));
+            CHECK(parser.feed(str.data() + split, str.size() - split));
+            CHECK(parser.finish());
+            CHECK(parser.root() == expected);
+        }
+        myjson::stream_parser parser;
+        for (char c : str) {
+            parser.feed(&c, 1);
+        }
+        CHECK(parser.finish());
+        CHECK(parser.root() == expected);
+    }
+
+    myjson::stream_parser parser;
+    parser.feed("[1, 2");
+    myjson::parse_result result = parser.finish();
+    CHECK(result.error == myjson::parse_error::unexpected_end);
+    CHECK(result.offset == 5);
+    parser.reset();
+    parser.feed("{\"a\":1}");
+    result = parser.feed(" x");
+    CHECK(result.error == myjson::parse_error::trailing_characters);
+    CHECK(result.offset == 8);
+    parser.reset();
+    CHECK(parser.feed("[\"a\",\n \"b\" \"c\"]").error ==
+          myjson::parse_error::expected_comma_or_bracket);
+    CHECK(parser.status().line == 2);
+    CHECK(parser.status().column == 6);
+}
+
+// Binary formats
+static void test_binary() {
+    CHECK(myjson::to_cbor(myjson::json(1)) == std::vector<uint8_t>{0x01});
+    CHECK(myjson::to_cbor(myjson::json(-1)) == std::vector<uint8_t>{0x20});
+    CHECK(myjson::to_cbor(myjson::parse("[1,true,null]")) ==
+          (std::vector<uint8_t>{0x83, 0x01, 0xf5, 0xf6}));
+    CHECK(myjson::to_msgpack(myjson::parse("{\"a\":1}")) ==
+          (std::vector<uint8_t>{0x81, 0xa1, 'a', 0x01}));
+    CHECK(myjson::to_msgpack(myjson::json(-33)) ==
+          (std::vector<uint8_t>{0xd0, 0xdf}));
+
+    myjson::json value = myjson::parse(
+        "{\"s\":\"a string longer than the inline buffer\",\"n\":[0,-1,23,"
+        "24,255,256,65535,65536,4294967296,-9223372036854775808,1.5,"
+        "1e300,-0.0],\"o\":{\"\":{}},\"b\":[true,false,null,[]]}");
+    CHECK(myjson::from_cbor(myjson::to_cbor(value)) == value);
+    CHECK(myjson::from_msgpack(myjson::to_msgpack(value)) == value);
+
+    std::vector<uint8_t> truncated = myjson::to_cbor(value);
+    truncated.pop_back();
+    myjson::json out;
+    CHECK(!myjson::from_cbor(truncated.data(), truncated.size(), out));
+    std::vector<uint8_t> trailing = myjson::to_msgpack(value);
+    trailing.push_back(0xc0);
+    CHECK(!myjson::from_msgpack(trailing.data(), trailing.size(), out));
+    CHECK(throws([&] { myjson::from_cbor(truncated); }));
+    // input that ends inside the argument of an item
+    const std::vector<uint8_t> arguments[] = {
+        {0x18}, {0x19, 0x01}, {0x1a, 0x01, 0x02, 0x03}, {0x9a, 0x01}};
+    for (const std::vector<uint8_t>& bytes : arguments) {
+        CHECK(myjson::from_cbor(bytes.data(), bytes.size(), out).error ==
+              myjson::parse_error::unexpected_end);
+    }
+}
+
+// Paths
+static void test_paths() {
+    myjson::json value = myjson::parse(
+        "{\"a\":{\"b\":[10,20,{\"c\":\"x\"}]},\"m~n\":1,\"p/q\":2,\"\":3}");
+    const myjson::json& view = value;
+    CHECK(*myjson::json_pointer("/a/b/1").find(view) == myjson::json(20));
+    CHECK(*myjson::json_pointer("/a/b/2/c").find(view) == myjson::json("x"));
+    CHECK(*myjson::json_pointer("/m~0n").find(view) == myjson::json(1));
+    CHECK(*myjson::json_pointer("/p~1q").find(view) == myjson::json(2));
+    CHECK(*myjson::json_pointer("/").find(view) == myjson::json(3));
+    CHECK(myjson::json_pointer("").find(view) == &view);
+    CHECK(myjson::json_pointer("/a/b/3").find(view) == nullptr);
+    CHECK(myjson::json_pointer("/a/b/01").find(view) == nullptr);
+    CHECK(myjson::json_pointer("/a/x").find(view) == nullptr);
+    CHECK(throws([] { myjson::json_pointer("a"); }));
+
+    CHECK(*myjson::json_path("a.b[2].c").find(view) == myjson::json("x"));
+    CHECK(myjson::json_path("a.b[0]").contains(view));
+    CHECK(!myjson::json_path("a.c").contains(view));
+    CHECK(throws([] { myjson::json_path("a..b"); }));
+    CHECK(throws([] { myjson::json_path("a[1"); }));
+    CHECK(throws([] { myjson::json_path("x.arr[0]b"); }));
+    CHECK(throws([] { myjson::json_path("a[0]]"); }));
+    CHECK(myjson::json_path("a.b[1][0]").find(view) == nullptr);
+    CHECK(myjson::json_path("[0]").find(view) == nullptr);
+
+    *myjson::json_path("a.b[0]").find(value) = myjson::json(11);
+    CHECK(value["a"]["b"][0] == myjson::json(11));
+
+    std::string text = value.dump();
+    myjson::lazy_document document(text);
+    CHECK(myjson::json_path("a.b[2].c")
+              .find(document.root())
+              .get<std::string>() == "x");
+}
+
+// Patch
+static void check_patch(const char* document, const char* patch,
+                        const char* expected) {
+    myjson::json value = myjson::parse(document);
+    myjson::apply_patch(value, myjson::parse(patch));
+    CHECK(value == myjson::parse(expected));
+}
+
+static void test_patch() {
+    // RFC 6902 appendix A
+    check_patch("{\"foo\":\"bar\"}",
+                "[{\"op\":\"add\",\"path\":\"/baz\",\"value\":\"qux\"}]",
+                "{\"baz\":\"qux\",\"foo\":\"bar\"}");
+    check_patch("{\"foo\":[\"bar\",\"baz\"]}",
+                "[{\"op\":\"add\",\"path\":\"/foo/1\",\"value\":\"qux\"}]",
+                "{\"foo\":[\"bar\",\"qux\",\"baz\"]}");
+    check_patch("{\"foo\":[\"bar\",\"qux\",\"baz\"]}",
+                "[{\"op\":\"remove\",\"path\":\"/foo/1\"}]",
+                "{\"foo\":[\"bar\",\"baz\"]}");
+    check_patch("{\"baz\":\"qux\",\"foo\":\"bar\"}",
+                "[{\"op\":\"replace\",\"path\":\"/baz\",\"value\":\"boo\"}]",
+                "{\"baz\":\"boo\",\"foo\":\"bar\"}");
+    check_patch("{\"foo\":[\"all\",\"grass\",\"cows\",\"eat\"]}",
+                "[{\"op\":\"move\",\"from\":\"/foo/1\",\"path\":\"/foo/3\"}]",
+                "{\"foo\":[\"all\",\"cows\",\"eat\",\"grass\"]}");
+    check_patch("{\"a\":{\"b\":1}}",
+                "[{\"op\":\"copy\",\"from\":\"/a\",\"path\":\"/c\"},"
+                "{\"op\":\"add\",\"path\":\"/c/-\",\"value\":2}]",
+                "{\"a\":{\"b\":1},\"c\":{\"b\":1,\"-\":2}}");
+    check_patch("{\"foo\":[\"bar\"]}",
+                "[{\"op\":\"add\",\"path\":\"/foo/-\",\"value\":[1]}]",
+                "{\"foo\":[\"bar\",[1]]}");
+
+    myjson::json value = myjson::parse("{\"baz\":\"qux\"}");
+    CHECK(throws([&] {
+        myjson::apply_patch(
+            value, myjson::parse("[{\"op\":\"test\",\"path\":\"/baz\","
+                                 "\"value\":\"bar\"}]"));
+    }));
+    CHECK(throws([&] {
+        myjson::apply_patch(value,
+                            myjson::parse("[{\"op\":\"add\",\"path\":\"/x/y\","
+                                          "\"value\":1}]"));
+    }));
+    // operations before the failing one stay applied
+    CHECK(throws([&] {
+        myjson::apply_patch(value,
+                            myjson::parse("[{\"op\":\"add\",\"path\":\"/n\","
+                                          "\"value\":1},{\"op\":\"remove\","
+                                          "\"path\":\"/missing\"}]"));
+    }));
+    CHECK(value == myjson::parse("{\"baz\":\"qux\",\"n\":1}"));
+
+    // test compares numbers by value, RFC 6902 section 4.6
+    value = myjson::parse("{\"n\":1,\"a\":[2.0,{\"b\":-0.0}],"
+                          "\"big\":9007199254740993}");
+    CHECK(!throws([&] {
+        myjson::apply_patch(
+            value, myjson::parse("[{\"op\":\"test\",\"path\":\"/n\","
+                                 "\"value\":1.0},{\"op\":\"test\","
+                                 "\"path\":\"/a\",\"value\":[2,{\"b\":0}]}]"));
+    }));
+    const char* unequal[] = {"1.5", "\"1\"", "true", "1e300"};
+    for (const char* number : unequal) {
+        CHECK(throws([&] {
+            myjson::apply_patch(
+                value,
+                myjson::parse(std::string("[{\"op\":\"test\",\"path\":"
+                                          "\"/n\",\"value\":") +
+                              number + "}]"));
+        }));
+    }
+    // 2^53 + 1 is not the double next to it
+    CHECK(throws([&] {
+        myjson::apply_patch(
+            value, myjson::parse("[{\"op\":\"test\",\"path\":\"/big\","
+                                 "\"value\":9007199254740992.0}]"));
+    }));
+
+    // RFC 7396 appendix A
+    const char* merges[][3] = {
+        {"{\"a\":\"b\"}", "{\"a\":\"c\"}", "{\"a\":\"c\"}"},
+        {"{\"a\":\"b\"}", "{\"a\":null}", "{}"},
+        {"{\"a\":[\"b\"]}", "{\"a\":\"c\"}", "{\"a\":\"c\"}"},
+        {"{\"a\":{\"b\":\"c\"}}", "{\"a\":{\"b\":\"d\",\"c\":null}}",
+         "{\"a\":{\"b\":\"d\"}}"},
+        {"[1,2]", "{\"a\":\"b\",\"c\":null}", "{\"a\":\"b\"}"},
+        {"{}", "{\"a\":{\"bb\":{\"ccc\":null}}}", "{\"a\":{\"bb\":{}}}"},
+        {"{\"a\":\"foo\"}", "null", "null"},
+    };
+    for (const auto& merge : merges) {
+        myjson::json target = myjson::parse(merge[0]);
+        myjson::merge_patch(target, myjson::parse(merge[1]));
+        CHECK(target == myjson::parse(merge[2]));
+    }
+
+    const char* pairs[][2] = {
+        {"{\"a\":1,\"b\":[1,2,3],\"c\":{\"d\":\"x\"}}",
+         "{\"a\":2,\"b\":[1,5],\"c\":{\"e\":\"y\"},\"f/g~\":null}"},
+        {"[1,2]", "[1,2,3,{\"a\":[]}]"},
+        {"[1,{\"a\":[1,2]},3,4]", "[0,{\"a\":[1]}]"},
+        {"1", "{\"a\":1}"},
+    };
+    for (const auto& pair : pairs) {
+        myjson::json source = myjson::parse(pair[0]);
+        myjson::json target = myjson::parse(pair[1]);
+        myjson::json patch = myjson::diff(source, target);
+        myjson::apply_patch(source, patch);
+        CHECK(source == target);
+    }
+    CHECK(myjson::diff(myjson::parse("{\"a\":[1]}"),
+                       myjson::parse("{\"a\":[1]}"))
+              .as_array()
+              .empty());
+    // no replace for a number written differently
+    CHECK(myjson::diff(myjson::parse("{\"a\":[1,2.5]}"),
+                       myjson::parse("{\"a\":[1.0,2.5]}"))
+              .as_array()
+              .empty());
+    CHECK(myjson::diff(myjson::parse("[1]"), myjson::parse("[1.5]"))
+              .as_array()
+              .size() == 1);
+}
+
+// Files
+static void write_file(const char* path, const std::string& text) {
+    std::FILE* file = std::fopen(path, "wb");
+    std::fwrite(text.data(), 1, text.size(), file);
+    std::fclose(file);
+}
+
+static void test_parse_file() {
+    const char* path = "myjson_unit_test.json";
+    const std::string text =
+        "{\"s\":\"a string longer than the inline buffer\",\"a\":[1,2]}";
+    write_file(path, text);
+    const myjson::json expected = myjson::parse(text);
+
+    // strings are copied out of the mapping, which ends with the call
+    myjson::parse_options zero_copy;
+    zero_copy.zero_copy_strings = true;
+    myjson::json out;
+    CHECK(myjson::parse_file(path, out, zero_copy));
+    CHECK(out == expected);
+    CHECK(myjson::parse_file(path) == expected);
+
+    // the document keeps the mapping until the next parse
+    myjson::document doc;
+    doc.parse_file(path, zero_copy);
+    CHECK(doc.root() == expected);
+    doc.parse_file(path);
+    CHECK(doc.root()["s"] == expected["s"]);
+    doc.parse("[]");
+    CHECK(doc.root().as_array().empty());
+
+    write_file(path, "[1,");
+    CHECK(myjson::parse_file(path, out).error ==
+          myjson::parse_error::unexpected_end);
+    CHECK(throws([&] { myjson::parse_file(path); }));
+    write_file(path, "");
+    CHECK(myjson::parse_file(path, out).error ==
+          myjson::parse_error::unexpected_end);
+    std::remove(path);
+
+    CHECK(myjson::parse_file(path, out).error ==
+          myjson::parse_error::file_error);
+    CHECK(throws([&] { myjson::parse_file(path); }));
+    CHECK(throws([&] { doc.parse_file(path); }));
+}
+
+// Struct binding
+struct point {
+    int x = 0;
+    double y = 0;
+};
+MYJSON_DEFINE(point, x, y)
+
+struct shape {
+    std::string name;
+    std::vector<point> points;
+    std::optional<std::string> label;
+    std::map<std::string, int> counts;
+    bool closed = false;
+};
+MYJSON_DEFINE(shape, name, points, label, counts, closed)
+
+struct ranges {
+    int8_t small = 7;
+    unsigned count = 7;
+    int64_t wide = 7;
+    float ratio = 7;
+};
+MYJSON_DEFINE(ranges, small, count, wide, ratio)
+
+static void test_parse_into() {
+    shape in;
+    in.name = "triangle";
+    in.points = {{0, 0.5}, {1, -2}, {3, 4.25}};
+    in.counts = {{"a", 1}, {"b", 2}};
+    in.closed = true;
+    std::string text = myjson::dump(in);
+    CHECK(myjson::parse(text) ==
+          myjson::parse("{\"name\":\"triangle\",\"points\":[{\"x\":0,"
+                        "\"y\":0.5},{\"x\":1,\"y\":-2.0},{\"x\":3,\"y\":4.25}],"
+                        "\"label\":null,\"counts\":{\"a\":1,\"b\":2},"
+                        "\"closed\":true}"));
+    shape out;
+    CHECK(myjson::parse_into(text, out));
+    CHECK(out.name == in.name);
+    CHECK(out.points.size() == 3);
+    CHECK(out.points[2].x == 3 && out.points[2].y == 4.25);
+    CHECK(!out.label.has_value());
+    CHECK(out.counts == in.counts);
+    CHECK(out.closed);
+
+    // unknown members are skipped, a member of another type is left alone
+    point p{5, 6};
+    CHECK(myjson::parse_into("{\"z\":[1,{}],\"x\":\"no\",\"y\":2}", p));
+    CHECK(p.x == 5 && p.y == 2);
+    // numbers convert between int and float
+    CHECK(myjson::parse_into("{\"x\":2.0,\"y\":3}", p));
+    CHECK(p.x == 2 && p.y == 3);
+    // a number out of the member's range leaves it alone too
+    CHECK(myjson::parse_into("{\"x\":1e40,\"y\":4}", p));
+    CHECK(p.x == 2 && p.y == 4);
+    const char* out_of_range[] = {
+        "{\"small\":300}",      "{\"small\":128.0}",
+        "{\"small\":-129}",     "{\"count\":-1}",
+        "{\"count\":4294967296}", "{\"count\":-1.5}",
+        "{\"wide\":1e40}",       "{\"wide\":9223372036854775808.0}",
+        "{\"ratio\":1e40}",      "{\"wide\":18446744073709551615}",
+    };
+    for (const char* text : out_of_range) {
+        ranges r;
+        CHECK(myjson::parse_into(text, r));
+        CHECK(r.small == 7 && r.count == 7 && r.wide == 7 && r.ratio == 7);
+    }
+    ranges r;
+    CHECK(myjson::parse_into("{\"small\":-128.9,\"count\":4294967295,"
+                             "\"wide\":-9223372036854775808.0,"
+                             "\"ratio\":2}",
+                             r));
+    CHECK(r.small == -128 && r.count == 4294967295u);
+    CHECK(r.wide == INT64_MIN && r.ratio == 2);
+    int converted = 5;
+    myjson::from_json(myjson::parse("1e40"), converted);
+    CHECK(converted == 5);
+    myjson::from_json(myjson::parse("-2147483648.5"), converted);
+    CHECK(converted == INT32_MIN);
+    // get() of a value from_json() leaves alone is T()
+    CHECK(myjson::parse("\"7\"").get<int64_t>() == 0);
+    CHECK(myjson::parse("1e40").get<int>() == 0);
+
+    myjson::parse_result result = myjson::parse_into("{\"x\":1,", p);
+    CHECK(result.error == myjson::parse_error::unexpected_end);
+    CHECK(result.offset == 7);
+    CHECK(throws([] { myjson::parse_into<point>("[1"); }));
+}
+
+// Reserved storage
+static void test_reserve() {
+    myjson::json elements = myjson::json::array(100);
+    CHECK(elements.as_array().empty());
+    CHECK(elements.as_array().capacity() >= 100);
+    const myjson::json* first = elements.as_array().data();
+    for (int i = 0; i < 100; i++) {
+        elements.push(myjson::json(i));
+    }
+    CHECK(elements.as_array().data() == first);
+    elements.reserve(1000);
+    CHECK(elements.as_array().capacity() >= 1000);
+    CHECK(elements[99] == myjson::json(99));
+
+    // members stay in place, the flat and hash backends do not regrow
+    myjson::json object = myjson::parse("{}");
+    object.reserve(50);
+    object["key0"] = 0;
+    const myjson::json* member = &object["key0"];
+    for (int i = 1; i < 50; i++) {
+        object["key" + std::to_string(i)] = i;
+    }
+    CHECK(&object["key0"] == member);
+    CHECK(object["key49"] == myjson::json(49));
+    CHECK(throws([] { myjson::json(1).reserve(2); }));
+
+    // and in an arena
+    myjson::document doc;
+    doc.parse("{\"a\":[]}");
+    doc.root()["a"].reserve(10);
+    CHECK(doc.root()["a"].as_array().capacity() >= 10);
+    CHECK(doc.root()["a"].as_array().get_allocator().resource() ==
+          doc.resource());
+
+    // the structural index sizes arrays exactly
+    const myjson::json parsed = myjson::parse(
+        "[[1,2,3],[],[{\"a\":[4,5]},6],7]", structural_options());
+    CHECK(parsed.as_array().capacity() == 4);
+    CHECK(parsed[0].as_array().capacity() == 3);
+    CHECK(parsed[2].as_array().capacity() == 2);
+    CHECK(parsed[2][0]["a"].as_array().capacity() == 2);
+    doc.parse("[[1,2,3],[4]]", structural_options());
+    CHECK(doc.root()[0].as_array().capacity() == 3);
+}
+
+// Sharing
+// same storage, so copies of a shared tree are not deep
+static bool same_array(const myjson::json& a, const myjson::json& b) {
+    return &a.as_array() == &b.as_array();
+}
+
+static void test_share() {
+    const std::string text =
+        "{\"a\":[1,\"a string longer than the inline buffer\"],"
+        "\"b\":[[2],{\"c\":3}],\"s\":\"short\"}";
+    const myjson::json expected = myjson::parse(text);
+    myjson::json tree = myjson::parse(text);
+    tree.share();
+    CHECK(tree.is_shared());
+    CHECK(tree["a"].is_shared() && tree["a"][1].is_shared());
+    CHECK(!tree["s"].is_shared());
+    CHECK(tree == expected);
+
+    // a write copies the nodes on its path, the rest stays shared
+    myjson::json copy = tree;
+    const myjson::json& view = copy;
+    const myjson::json& original = tree;
+    CHECK(same_array(view["b"], original["b"]));
+    copy["a"][0] = 5;
+    CHECK(tree == expected);
+    CHECK(copy["a"][0] == myjson::json(5));
+    CHECK(!same_array(view["a"], original["a"]));
+    CHECK(same_array(view["b"], original["b"]));
+    CHECK(view["a"][1].get_string_view() ==
+          original["a"][1].get_string_view());
+    CHECK(view["a"][1].get_string_view().data() ==
+          original["a"][1].get_string_view().data());
+
+    // values added afterwards are deep until the next share()
+    copy["b"][0].push(myjson::parse("[\"a string longer than the inline "
+                                   "buffer\"]"));
+    CHECK(!view["b"][0][1].is_shared());
+    CHECK(original["b"] == expected["b"]);
+    copy.share();
+    CHECK(view["b"][0][1].is_shared());
+    myjson::json again = copy;
+    CHECK(same_array(again["b"][0][1], view["b"][0][1]));
+    CHECK(copy.dump() == again.dump());
+
+    // an arena gets a deep copy, it never releases references
+    myjson::document doc;
+    doc.root() = tree;
+    doc.root()["copy"] = copy["b"];
+    doc.root()["moved"] = std::move(again);
+    doc.root()["a"].push(tree["a"][1]);
+    CHECK(!doc.root().is_shared() && !doc.root()["moved"]["b"].is_shared());
+    CHECK(!doc.root()["a"][2].is_shared());
+    CHECK(doc.root()["a"][2] == expected["a"][1]);
+    CHECK(doc.root()["copy"] == copy["b"] && doc.root()["moved"] == copy);
+    CHECK(doc.root()["moved"]["b"][0].as_array().get_allocator().resource() ==
+          doc.resource());
+    // and its nodes cannot be shared, a heap copy of them can
+    CHECK(throws([&] { doc.root()["a"].share(); }));
+    myjson::json heap = doc.root();
+    heap.share();
+    CHECK(heap.is_shared() && heap == doc.root());
+    std::pmr::unsynchronized_pool_resource pool;
+    myjson::json pooled(tree, myjson::json::allocator_type(&pool));
+    CHECK(!pooled.is_shared() && pooled == expected);
+    CHECK(pooled["a"].as_array().get_allocator().resource() == &pool);
+
+    // any number of threads may copy and read it at once
+#if !defined(MYJSON_NO_THREADS)
+    std::vector<std::thread> readers;
+    std::vector<int> equal(4, 0);
+    for (size_t i = 0; i < equal.size(); i++) {
+        readers.emplace_back([&, i] {
+            for (int n = 0; n < 100; n++) {
+                myjson::json local = tree;
+                equal[i] += local == expected;
+            }
+        });
+    }
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    CHECK(equal == std::vector<int>(4, 100));
+#endif
+}
+
+// Arena trees
+// values assigned into a document are copied into its arena, anything left
+// on the heap is reported by LeakSanitizer (part of -fsanitize=address)
+static void test_document_assign() {
+    const std::string text(100, 'x');
+    myjson::document doc;
+    doc.parse("{\"n\":1,\"s\":\"short\",\"a\":[1],\"z\":null,"
+              "\"l\":\"a string longer than the inline buffer\"}");
+    myjson::json& root = doc.root();
+    // over nodes without storage of their own
+    root["new"] = text;
+    root["n"] = myjson::parse("{\"k\":[1,\"" + text + "\"]}");
+    const myjson::json tree = myjson::parse("[\"" + text + "\"]");
+    root["s"] = tree;
+    root["z"] = std::string(text);
+    // and over long strings, arrays and objects
+    root["l"] = text;
+    root["a"] = myjson::parse("[{\"" + text + "\":\"" + text + "\"}]");
+    CHECK(root["new"].get_string_view() == text);
+    CHECK(root["n"]["k"][1].get_string_view() == text);
+    CHECK(root["s"] == tree);
+    CHECK(root["z"].get_string_view() == text);
+    CHECK(root["l"].get_string_view() == text);
+    CHECK(root["n"].as_object().get_allocator().resource() == doc.resource());
+    CHECK(root["s"].as_array().get_allocator().resource() == doc.resource());
+    CHECK(root["a"].as_array().get_allocator().resource() == doc.resource());
+    CHECK(root["a"][0].as_object().get_allocator().resource() ==
+          doc.resource());
+    // the old tree is released, not destroyed, when parse() starts over
+    doc.parse("[1]");
+    doc.root()[0] = myjson::parse("{\"" + text + "\":1}");
+    CHECK(doc.root().dump() == "[{\"" + text + "\": 1}]");
+    doc.root() = myjson::parse("[\"" + text + "\"]");
+    CHECK(doc.root().as_array().get_allocator().resource() == doc.resource());
+
+    // nodes in the blocks the arena adds once the first one is full
+    myjson::document small(256);
+    small.parse("[]");
+    for (int i = 0; i < 200; i++) {
+        small.root().push(myjson::json());
+        small.root()[i] = std::string(text);
+    }
+    CHECK(small.root()[199].get_string_view() == text);
+
+    myjson::document nested;
+    nested.parse("{\"n\":{\"k\":[1,2]}}");
+    nested.root() = nested.root()["n"];
+    CHECK(nested.root()["k"][0] == myjson::json(1));
+    // and into the results of a parser, which reuses its arena
+    myjson::parser reused;
+    CHECK(reused.parse("{\"a\":1,\"b\":[2]}"));
+    reused.root()["a"] = text;
+    reused.root()["b"] = myjson::parse("{\"" + text + "\":1}");
+    CHECK(reused.root()["a"].get_string_view() == text);
+    CHECK(reused.root()["b"].as_object().get_allocator().resource() ==
+          reused.resource());
+    CHECK(reused.parse("[1]"));
+    reused.root()[0] = std::string(text);
+    CHECK(reused.root()[0].get_string_view() == text);
+    // in the blocks the arena grows by, and in the one block reset() then
+    // replaces them with
+    std::string records = "[";
+    for (int i = 0; i < 200; i++) {
+        records += i == 0 ? "{\"s\":null}" : ",{\"s\":null}";
+    }
+    records += "]";
+    myjson::parser growing(myjson::parse_options(), 256);
+    for (int pass = 0; pass < 3; pass++) {
+        CHECK(growing.parse(records));
+        growing.root()[199]["s"] = text;
+        growing.root()[0] = myjson::parse("[\"" + text + "\"]");
+        CHECK(growing.root()[199]["s"].get_string_view() == text);
+        CHECK(growing.root()[0].as_array().get_allocator().resource() ==
+              growing.resource());
+    }
+    // NDJSON records live in the arena of their slot, unordered ones are
+    // assigned into on the worker threads
+    std::string lines;
+    for (int i = 0; i < 100; i++) {
+        lines += "{\"s\":1}\n";
+    }
+    for (bool ordered : {true, false}) {
+        std::atomic<size_t> assigned{0};
+        myjson::ndjson_options ndjson;
+        ndjson.threads = 4;
+        ndjson.chunk_size = 64;
+        ndjson.ordered = ordered;
+        CHECK(myjson::parse_ndjson(
+            lines,
+            [&](myjson::json& record) {
+                record["s"] = text;
+                record["l"] = myjson::parse("[1]");
+                assigned += record["s"].get_string_view() == text;
+            },
+            ndjson));
+        CHECK(assigned == 100);
+    }
+
+    // heap trees are left alone
+    myjson::json heap = myjson::parse("{\"a\":1}");
+    heap["a"] = text;
+    CHECK(heap["a"].get_string_view() == text);
+}
+
+// Differential checks
+// random edits of a few documents, so most inputs are close to valid json
+// and fail deep inside a value
+static const char* fuzz_documents[] = {
+    "{\"a\":[1,-2.5e+3,0.25,true,false,null],\"b\":{\"c\":\"x\\ny\"}}",
+    "[0,-0,10,1E5,1e-7,\"\\u00e9\\\"\",[],{},[[1,2],[3]]]",
+    "{\"key\" : \"value\",\n \"list\" : [ 1 , 2 , 3 ],\n \"k\":-2.5}",
+    "\"top \\t level\"",
+    "12345",
+};
+
+static std::string mutate(std::mt19937& random, std::string text) {
+    static const char bytes[] = "[]{},:\"\\ \n-+.eE0123456789truefalsnx";
+    size_t edits = 1 + random() % 3;
+    for (size_t i = 0; i < edits; i++) {
+        size_t at = text.empty() ? 0 : random() % text.size();
+        char c = bytes[random() % (sizeof(bytes) - 1)];
+        switch (random() % 3) {
+            case 0:
+                if (!text.empty()) {
+                    text[at] = c;
+                }
+                break;
+            case 1: text.insert(text.begin() + at, c); break;
+            default:
+                if (!text.empty()) {
+                    text.erase(at, 1);
+                }
+        }
+    }
+    return text;
+}
+
+static bool same_result(const myjson::parse_result& a,
+                        const myjson::parse_result& b) {
+    return a.error == b.error && a.offset == b.offset && a.line == b.line &&
+           a.column == b.column;
+}
+
+// number of inputs on which check(text) is false, the first is printed
+template <class Check>
+static size_t count_mismatches(const char* name, size_t count, Check check) {
+    std::mt19937 random(12345);
+    size_t mismatches = 0;
+    for (size_t i = 0; i < count; i++) {
+        const char* seed = fuzz_documents[i % (sizeof(fuzz_documents) /
+                                               sizeof(fuzz_documents[0]))];
+        std::string text = mutate(random, seed);
+        if (!check(random, text) && mismatches++ == 0) {
+            std::cerr << name << " differs from parse() on: " << text << "\n";
+        }
+    }
+    return mismatches;
+}
+
+// the stream parser, fed in chunks of random size, gives the same result
+// and error position as parse()
+static void test_stream_differential() {
+    size_t mismatches = count_mismatches(
+        "stream_parser", 20000,
+        [](std::mt19937& random, const std::string& text) {
+            myjson::json expected;
+            myjson::parse_result result = myjson::parse(text, expected);
+            myjson::stream_parser parser;
+            for (size_t i = 0; i < text.size();) {
+                size_t size = std::min<size_t>(1 + random() % 8,
+                                               text.size() - i);
+                parser.feed(text.data() + i, size);
+                i += size;
+            }
+            myjson::parse_result streamed = parser.finish();
+            return same_result(result, streamed) &&
+                   (!result || parser.root() == expected);
+        });
+    CHECK(mismatches == 0);
+
+    const char* numbers[] = {"[01]", "[1-2]", "{\"k\":-2.5-3}", "[1.5.2]",
+                             "[1e5e5]", "[-01]", "0x", "[1ee]", "[--1]"};
+    for (const char* text : numbers) {
+        myjson::json out;
+        myjson::stream_parser parser;
+        parser.feed(text);
+        CHECK(same_result(parser.finish(), myjson::parse(text, out)));
+    }
+}
+
+// the structural index gives the same result and error position as the
+// scanning parser
+static void test_structural_differential() {
+    size_t mismatches = count_mismatches(
+        "use_structural_index", 20000,
+        [](std::mt19937&, const std::string& text) {
+            myjson::json expected, indexed;
+            myjson::parse_result result = myjson::parse(text, expected);
+            myjson::parse_result structural =
+                myjson::parse(text, indexed, structural_options());
+            return same_result(result, structural) &&
+                   (!result || indexed == expected);
+        });
+    CHECK(mismatches == 0);
+
+    const char* documents[] = {"[01]", "[nulll]", "{\"a\":truex}", "1x",
+                               "[\"\\x\", \"unbalanced]", "[1 \"a]"};
+    myjson::parser reused(structural_options());
+    for (const char* text : documents) {
+        myjson::json out;
+        myjson::parse_result result = myjson::parse(text, out);
+        CHECK(same_result(myjson::parse(text, out, structural_options()),
+                          result));
+        CHECK(same_result(reused.parse(text), result));
+    }
+    // and the throwing parse() ends the value at the same place
+    CHECK(myjson::parse("1x", structural_options()) == myjson::json(1));
+    CHECK(myjson::parse("[1]]", structural_options()) == myjson::parse("[1]"));
+}
+
+// Lazy document
+static void test_lazy() {
+    std::string text =
+        "{\"id\":7,\"tags\":[\"a\",\"b\",\"c\"],\"user\":{\"name\":\"x\","
+        "\"score\":1.5},\"id\":8}";
+    myjson::lazy_document document(text);
+    CHECK(document.status());
+    myjson::lazy_json root = document.root();
+    CHECK(root.get_type() == myjson::json::Type::_object);
+    CHECK(root.size() == 4);
+    // the first of repeated keys
+    CHECK(root["id"].get<int64_t>() == 7);
+    CHECK(root["tags"].size() == 3);
+    CHECK(root["tags"][2].get<std::string>() == "c");
+    CHECK(root["tags"].raw() == "[\"a\",\"b\",\"c\"]");
+    CHECK(root["user"]["score"].get<double>() == 1.5);
+    CHECK(root["user"].value() ==
+          myjson::parse("{\"name\":\"x\",\"score\":1.5}"));
+    CHECK(!root.find("missing").valid());
+    CHECK(!root["tags"].find(3).valid());
+    CHECK(!root["id"].find("x").valid());
+    CHECK(root.contains("user"));
+    CHECK(throws([&] { root["missing"]; }));
+
+    myjson::lazy_document numbers("[1x, 2]");
+    CHECK(throws([&] { numbers.root()[0].value(); }));
+    CHECK(numbers.root()[1].get<int>() == 2);
+
+    myjson::lazy_document broken("[\"unterminated");
+    CHECK(!broken.status());
+    CHECK(throws([&] { broken.root(); }));
+}
+
+// NDJSON
+static void test_ndjson() {
+    std::string text;
+    for (int i = 0; i < 1000; i++) {
+        text += "{\"i\":" + std::to_string(i) + ",\"s\":\"record\"}\n";
+        if (i % 100 == 0) {
+            text += "\n";
+        }
+    }
+    myjson::ndjson_options options;
+    options.threads = 4;
+    options.chunk_size = 512;
+    int64_t next = 0;
+    bool in_order = true;
+    myjson::parse_result result = myjson::parse_ndjson(
+        text,
+        [&](myjson::json& record) {
+            in_order = in_order && record["i"].get<int64_t>() == next;
+            next++;
+        },
+        options);
+    CHECK(result);
+    CHECK(in_order);
+    CHECK(next == 1000);
+
+    // each slot keeps its builder and reader from chunk to chunk
+    options.threads = 1;
+    options.parse.intern_keys = true;
+    size_t matching = 0;
+    result = myjson::parse_ndjson(
+        text,
+        [&](myjson::json& record) {
+            matching += record["s"].get_string_view() == "record";
+        },
+        options);
+    CHECK(result);
+    CHECK(matching == 1000);
+
+    size_t delivered = 0;
+    result = myjson::parse_ndjson("[1]\n[2\n[3]\n",
+                                  [&](myjson::json&) { delivered++; });
+    CHECK(result.error == myjson::parse_error::unexpected_end);
+    CHECK(result.line == 2);
+    CHECK(delivered == 1);
+}
+
+// Parallel dump and parse
+static void test_parallel() {
+    std::string text = "[";
+    for (int i = 0; i < 1000; i++) {
+        text += i == 0 ? "" : ",";
+        text += "{\"i\":" + std::to_string(i) +
+                ",\"s\":\"a string longer than the inline buffer\","
+                "\"a\":[[],{\"k\":\"]\\\"[\"}]}";
+    }
+    text += "]";
+    const myjson::json expected = myjson::parse(text);
+    myjson::parallel_options parallel;
+    parallel.threads = 4;
+    parallel.chunk_size = 64;
+    myjson::json out;
+    CHECK(myjson::parse_parallel(text, out, parallel));
+    CHECK(out == expected);
+    CHECK(myjson::parse_parallel(" [ ] ", parallel) == myjson::parse("[]"));
+    // anything but an array is parsed on the calling thread
+    std::string object = "{\"a\":" + text + "}";
+    CHECK(myjson::parse_parallel(object, out, parallel));
+    CHECK(out["a"] == expected);
+
+    // a tree for an arena is built on the heap and copied into it, the
+    // workers would allocate from it at the same time otherwise
+    myjson::document doc;
+    CHECK(myjson::parse_parallel(text, doc.root(), parallel));
+    CHECK(doc.root() == expected);
+    CHECK(doc.root().as_array().get_allocator().resource() ==
+          doc.resource());
+    CHECK(doc.root()[999]["a"].as_array().get_allocator().resource() ==
+          doc.resource());
+    myjson::parse_options in_arena;
+    in_arena.resource = doc.resource();
+    CHECK(myjson::parse_parallel(text, out, parallel, in_arena));
+    CHECK(out == expected);
+    CHECK(out.as_array().get_allocator().resource() == doc.resource());
+    out = myjson::json();
+
+    // errors are found again by parse(), at the same offset
+    myjson::parse_result failed = myjson::parse(text + "x", out);
+    CHECK(same_result(myjson::parse_parallel(text + "x", out, parallel),
+                      failed));
+    std::string broken = text;
+    broken[broken.size() / 2] = '!';
+    failed = myjson::parse(broken, out);
+    CHECK(same_result(myjson::parse_parallel(broken, out, parallel), failed));
+    CHECK(throws([&] { myjson::parse_parallel(broken, parallel); }));
+
+    myjson::dump_options compact;
+    compact.compact = true;
+    for (const myjson::dump_options& options : {myjson::dump_options(),
+                                                 compact}) {
+        CHECK(myjson::dump_parallel(expected, parallel, options) ==
+              expected.dump(options));
+        CHECK(myjson::dump_parallel(myjson::parse(object), parallel,
+                                    options) ==
+              myjson::parse(object).dump(options));
+        std::ostringstream stream;
+        myjson::ostream_sink sink(stream);
+        myjson::dump_parallel_to(expected, sink, parallel, options);
+        CHECK(stream.str() == expected.dump(options));
+    }
+    CHECK(myjson::dump_parallel(myjson::parse("[]"), parallel) == "[]");
+    CHECK(myjson::dump_parallel(myjson::parse("{}"), parallel) == "{}");
+    CHECK(myjson::dump_parallel(myjson::json(1.5), parallel) == "1.5");
+}
+
+// Statistics
+static void test_stats() {
+    const std::string text =
+        "{\"a\":[1,2.5,\"x\",null,true,{\"k\":[]}],"
+        "\"s\":\"a string longer than the inline buffer\",\"e\":\"t\\tb\"}";
+    int calls = 0;
+    myjson::stats_operation operation = myjson::stats_operation::dump;
+    myjson::set_stats_callback(
+        [&](myjson::stats_operation done, const myjson::stats&) {
+            calls++;
+            operation = done;
+        });
+    const myjson::stats& counted = myjson::last_stats();
+    for (bool structural : {false, true}) {
+        myjson::parse_options options;
+        options.use_structural_index = structural;
+        myjson::json value = myjson::parse(text, options);
+#if defined(MYJSON_STATS)
+        CHECK(operation == myjson::stats_operation::parse);
+        CHECK(counted.bytes_scanned == text.size());
+        CHECK(counted.nulls == 1 && counted.bools == 1);
+        CHECK(counted.ints == 1 && counted.floats == 1);
+        CHECK(counted.strings == 3 && counted.keys == 4);
+        CHECK(counted.arrays == 2 && counted.objects == 2);
+        // both objects and arrays and the long string
+        CHECK(counted.allocations == 5);
+        CHECK(counted.max_depth == 4);
+        std::string dumped = value.dump();
+        CHECK(operation == myjson::stats_operation::dump);
+        CHECK(counted.bytes_scanned == dumped.size());
+        CHECK(counted.allocations == 0);
+#else
+        value.dump();
+        CHECK(counted.bytes_scanned == 0 && counted.keys == 0);
+#endif
+    }
+#if defined(MYJSON_STATS)
+    CHECK(calls == 4);
+#else
+    CHECK(calls == 0);
+#endif
+    myjson::set_stats_callback(nullptr);
+}
+
+int main() {
+    test_parse_result();
+    test_zero_copy();
+    test_roundtrip();
+    test_objects();
+    test_stream_parser();
+    test_stream_differential();
+    test_structural_differential();
+    test_lazy();
+    test_parse_into();
+    test_binary();
+    test_paths();
+    test_patch();
+    test_parse_file();
+    test_reserve();
+    test_share();
+    test_document_assign();
+    test_ndjson();
+    test_parallel();
+    test_stats();
+    if (failures != 0) {
+        std::cerr << failures << " of " << checks << " checks failed\n";
+        return 1;
+    }
+    std::cout << checks << " checks passed\n";
+    return 0;
+}